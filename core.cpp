@@ -4,9 +4,9 @@ Core::Core() :
     QObject(),
     imageLoader(NULL),
     dirManager(NULL),
-    currentImageAnimated(NULL),
-    currentVideo(NULL),
-    currentImagePos(0) {
+    currentImagePos(0),
+    showingPreview(false),
+    tileSourceSent(false) {
 }
 
 // ##############################################################
@@ -38,15 +38,29 @@ int Core::imageCount() {
 // ##############################################################
 
 void Core::updateInfoString() {
-    Image* img = currentImage();
+    QSharedPointer<Image> img = currentImage();
     QString infoString = "";
     infoString.append(" [ " +
                       QString::number(dirManager->currentPos + 1) +
                       "/" +
                       QString::number(dirManager->fileNameList.length()) +
                       " ]   ");
-    if(img) {
-        QString name, fullName = img->info()->fileName();
+    // until the image is decoded the metadata index is used
+    QString fullName;
+    QSize size;
+    int fileSize = 0;
+    ImageMetadata metadata;
+    if(img && !showingPreview) {
+        fullName = img->info()->fileName();
+        size = QSize(img->width(), img->height());
+        fileSize = img->info()->fileSize();
+    } else if(dirManager->metadataAt(dirManager->currentFilePos(), metadata)) {
+        fullName = metadata.name;
+        size = metadata.size;
+        fileSize = metadata.fileSize / 1024;
+    }
+    if(!fullName.isEmpty()) {
+        QString name;
         if(fullName.size()>95) {
             name = fullName.left(95);
             name.append(" (...) ");
@@ -56,11 +70,11 @@ void Core::updateInfoString() {
         }
         infoString.append(name + "  ");
         infoString.append("(" +
-                          QString::number(img->width()) +
+                          QString::number(size.width()) +
                           "x" +
-                          QString::number(img->height()) +
+                          QString::number(size.height()) +
                           "  ");
-        infoString.append(QString::number(img->info()->fileSize()) + " KB)");
+        infoString.append(QString::number(fileSize) + " KB)");
     }
 
     //infoString.append(" >>" + QString::number(cache->currentlyLoadedCount()));
@@ -116,13 +130,16 @@ void Core::setCurrentDir(QString path) {
 }
 
 void Core::rotateImage(int degrees) {
-    if(currentImage() != NULL) {
+    if(currentImage()) {
+        scaleGeneration.ref();
+        zoomSize = QSize();
+        tileSourceSent = false;
         currentImage()->rotate(degrees);
         ImageStatic *staticImage;
-        if((staticImage = dynamic_cast<ImageStatic *>(currentImage())) != NULL) {
-            emit imageAltered(currentImage()->getPixmap());
+        if((staticImage = dynamic_cast<ImageStatic *>(currentImage().data())) != NULL) {
+            emit imageAltered(currentImage()->sharedImage());
         }
-        else if ((currentVideo = dynamic_cast<Video *>(currentImage())) != NULL) {
+        else if((currentVideo = qSharedPointerDynamicCast<Video>(currentImage()))) {
             emit videoAltered(currentVideo->getClip());
         }
         updateInfoString();
@@ -132,7 +149,7 @@ void Core::rotateImage(int degrees) {
 void Core::setWallpaper(QRect wpRect) {
     if(currentImage()) {
         ImageStatic *staticImage;
-        if((staticImage = dynamic_cast<ImageStatic *>(currentImage())) != NULL) {
+        if((staticImage = dynamic_cast<ImageStatic *>(currentImage().data())) != NULL) {
             QImage *cropped = NULL;
             QRect screenRes = QApplication::desktop()->screenGeometry();
             if(cropped = staticImage->cropped(wpRect, screenRes, true)) {
@@ -146,44 +163,140 @@ void Core::setWallpaper(QRect wpRect) {
 }
 
 void Core::rescaleForZoom(QSize newSize) {
-    if(currentImage() && currentImage()->isLoaded()) {
+    if(!showingPreview && currentImage() && currentImage()->isLoaded()) {
+        int generation = scaleGeneration.fetchAndAddOrdered(1) + 1;
+        zoomSize = newSize;
         ImageLib imgLib;
-        float sourceSize = (float) currentImage()->width() *
-                           currentImage()->height() / 1000000;
+        QSize decodedSize = currentImage()->size();
+        ImageStatic *staticImage = dynamic_cast<ImageStatic *>(currentImage().data());
+        if(staticImage) {
+            decodedSize = staticImage->sharedImage().size();
+            // zoomed past the reduced display copy: decode the whole thing.
+            // Until it arrives the reduced copy is scaled up
+            if(staticImage->isReduced() &&
+               (newSize.width() > decodedSize.width() ||
+                newSize.height() > decodedSize.height()))
+            {
+                startFullDecode();
+            }
+        }
+        float sourceSize = (float) decodedSize.width() *
+                           decodedSize.height() / 1000000;
         float size = (float) newSize.width() *
                      newSize.height() / 1000000;
-        QPixmap *pixmap;
+        QImage scaled;
         float currentScale = (float) sourceSize / size;
         if(currentScale == 1.0) {
-            pixmap = currentImage()->getPixmap();
+            scaled = currentImage()->sharedImage();
         } else {
-            pixmap = new QPixmap(newSize);
-            if(settings->useFastScale() || currentScale < 1.0) {
-                imgLib.bilinearScale(pixmap, currentImage()->getPixmap(), newSize, true);
-            } else {
-                imgLib.bicubicScale(pixmap, currentImage()->getImage(), newSize.width(), newSize.height());
+            Resampler::Filter filter = (settings->useFastScale() || currentScale < 1.0) ?
+                                       Resampler::FILTER_BILINEAR : Resampler::FILTER_BICUBIC;
+            if(staticImage) {
+                // the pyramid keeps its levels alive
+                // even if the image is unloaded meanwhile
+                QtConcurrent::run(this, &Core::scaleInBackground,
+                                  staticImage->getPyramid(), newSize, filter, generation);
+                return;
             }
+            QImage source = currentImage()->sharedImage();
+            scaled = imgLib.scaled(&source, newSize, filter);
         }
-        emit scalingFinished(pixmap);
+        emit scalingFinished(scaled);
+    }
+}
+
+void Core::requestSourceImage() {
+    QImage source;
+    ImageStatic *staticImage = dynamic_cast<ImageStatic *>(currentImage().data());
+    if(!showingPreview && staticImage && staticImage->isLoaded()) {
+        // tiles come from the reduced copy until the full decode is done
+        if(staticImage->isReduced()) {
+            startFullDecode();
+        }
+        source = staticImage->sharedImage();
+        tileSourceSent = true;
+        // viewer switches to tiles, full size results are not needed
+        scaleGeneration.ref();
+    }
+    emit sourceImageReady(source);
+}
+
+// ignored if already running for this file
+void Core::startFullDecode() {
+    QSharedPointer<Image> img = currentImage();
+    if(!img || fullDecodePath == img->getPath()) {
+        return;
+    }
+    fullDecodePath = img->getPath();
+    // the job keeps the image alive even if the cache drops it
+    QtConcurrent::run(this, &Core::decodeFullResolution, img);
+}
+
+void Core::decodeFullResolution(QSharedPointer<Image> img) {
+    ImageStatic *staticImage = dynamic_cast<ImageStatic *>(img.data());
+    if(staticImage) {
+        staticImage->loadFullResolution();
+    }
+    QMetaObject::invokeMethod(this, "onFullResolutionReady", Qt::QueuedConnection,
+                              Q_ARG(QString, img->getPath()));
+}
+
+// swaps the full image in wherever the reduced one is shown
+void Core::onFullResolutionReady(QString path) {
+    if(fullDecodePath == path) {
+        fullDecodePath.clear();
+    }
+    QSharedPointer<Image> img = currentImage();
+    if(showingPreview || !img || img->getPath() != path) {
+        return;
+    }
+    if(tileSourceSent) {
+        emit sourceImageReady(img->sharedImage());
+    }
+    if(zoomSize.isValid()) {
+        rescaleForZoom(zoomSize);
+    }
+}
+
+void Core::scaleInBackground(QSharedPointer<ImagePyramid> pyramid, QSize newSize,
+                             Resampler::Filter filter, int generation)
+{
+    if(!pyramid || scaleGeneration.load() != generation) {
+        return;
+    }
+    // each halving cuts the work by 4x
+    QImage source = pyramid->nearest(newSize);
+    ImageLib imgLib;
+    QImage scaled = imgLib.scaled(&source, newSize, filter, &scaleGeneration, generation);
+    if(!scaled.isNull()) {
+        QMetaObject::invokeMethod(this, "onScalingFinished", Qt::QueuedConnection,
+                                  Q_ARG(QImage, scaled), Q_ARG(int, generation));
+    }
+}
+
+// QPixmap can only be made in gui thread
+void Core::onScalingFinished(QImage scaled, int generation) {
+    if(generation == scaleGeneration.load()) {
+        emit scalingFinished(scaled);
     }
 }
 
 void Core::startAnimation() {
     if(currentImageAnimated) {
         currentImageAnimated->animationStart();
-        connect(currentImageAnimated, SIGNAL(frameChanged(QPixmap *)),
-                this, SIGNAL(frameChanged(QPixmap *)), Qt::UniqueConnection);
+        connect(currentImageAnimated.data(), SIGNAL(frameChanged(QImage)),
+                this, SIGNAL(frameChanged(QImage)), Qt::UniqueConnection);
     }
 }
 
 void Core::stopAnimation() {
     if(currentImage()) {
-        if((currentImageAnimated = dynamic_cast<ImageAnimated *>(currentImage())) != NULL) {
+        if((currentImageAnimated = qSharedPointerDynamicCast<ImageAnimated>(currentImage()))) {
             currentImageAnimated->animationStop();
-            disconnect(currentImageAnimated, SIGNAL(frameChanged(QPixmap *)),
-                       this, SIGNAL(frameChanged(QPixmap *)));
+            disconnect(currentImageAnimated.data(), SIGNAL(frameChanged(QImage)),
+                       this, SIGNAL(frameChanged(QImage)));
         }
-        if((currentVideo = dynamic_cast<Video *>(currentImage())) != NULL) {
+        if((currentVideo = qSharedPointerDynamicCast<Video>(currentImage()))) {
             emit stopVideo();
         }
     }
@@ -202,17 +315,25 @@ void Core::initVariables() {
 void Core::connectSlots() {
     connect(imageLoader, SIGNAL(loadStarted()),
             this, SLOT(onLoadStarted()));
-    connect(imageLoader, SIGNAL(loadFinished(Image *, int)),
-            this, SLOT(onLoadFinished(Image *, int)));
+    connect(imageLoader, SIGNAL(loadFinished(QSharedPointer<Image>, int)),
+            this, SLOT(onLoadFinished(QSharedPointer<Image>, int)));
+    connect(imageLoader, SIGNAL(previewReady(QImage, QSize, int)),
+            this, SLOT(onPreviewReady(QImage, QSize, int)));
     connect(this, SIGNAL(thumbnailRequested(int)),
             imageLoader, SLOT(generateThumbnailFor(int)));
+    connect(this, SIGNAL(thumbnailRangeChanged(int, int)),
+            imageLoader, SLOT(setThumbnailRange(int, int)));
     connect(imageLoader, SIGNAL(thumbnailReady(int, Thumbnail *)),
             this, SIGNAL(thumbnailReady(int, Thumbnail *)));
     connect(cache, SIGNAL(initialized(int)), this, SIGNAL(cacheInitialized(int)), Qt::DirectConnection);
-    connect(dirManager, SIGNAL(directorySortingChanged()), imageLoader, SLOT(reinitCacheForced()));
+    connect(imageLoader, SIGNAL(fileAdded(int)), this, SLOT(onFileAdded(int)));
+    connect(imageLoader, SIGNAL(fileRemoved(int)), this, SLOT(onFileRemoved(int)));
+    connect(imageLoader, SIGNAL(fileListChanged(QVector<int>, int)),
+            this, SLOT(onFileListChanged(QVector<int>, int)));
+    connect(dirManager, SIGNAL(metadataIndexed()), this, SLOT(updateInfoString()));
 }
 
-Image* Core::currentImage() {
+QSharedPointer<Image> Core::currentImage() {
     return cache->imageAt(currentImagePos);
 }
 
@@ -224,21 +345,38 @@ void Core::onLoadStarted() {
     updateInfoString();
 }
 
-void Core::onLoadFinished(Image *img, int pos) {
+void Core::onPreviewReady(QImage preview, QSize realSize, int pos) {
+    Q_UNUSED(pos)
+    mutex.lock();
+    stopAnimation();
+    showingPreview = true;
+    scaleGeneration.ref();
+    zoomSize = QSize();
+    tileSourceSent = false;
+    emit signalSetImage(preview, realSize);
+    mutex.unlock();
+    updateInfoString();
+}
+
+void Core::onLoadFinished(QSharedPointer<Image> img, int pos) {
     mutex.lock();
+    showingPreview = false;
+    scaleGeneration.ref();
+    zoomSize = QSize();
+    tileSourceSent = false;
     emit signalUnsetImage();
 
     stopAnimation();
     currentImagePos = pos;
 
-    if((currentImageAnimated = dynamic_cast<ImageAnimated *>(img)) != NULL) {
+    if((currentImageAnimated = qSharedPointerDynamicCast<ImageAnimated>(img))) {
         startAnimation();
     }    
-    if((currentVideo = dynamic_cast<Video *>(img)) != NULL) {
+    if((currentVideo = qSharedPointerDynamicCast<Video>(img))) {
         emit videoChanged(currentVideo->getClip());
     }
     if(!currentVideo && img) {    //static image
-        emit signalSetImage(img->getPixmap());
+        emit signalSetImage(img->sharedImage(), img->size());
     }
 
     emit imageChanged(pos);
@@ -249,12 +387,15 @@ void Core::onLoadFinished(Image *img, int pos) {
 void Core::crop(QRect newRect) {
     if(currentImage()) {
         ImageStatic *staticImage;
-        if((staticImage = dynamic_cast<ImageStatic *>(currentImage())) != NULL) {
+        if((staticImage = dynamic_cast<ImageStatic *>(currentImage().data())) != NULL) {
+            scaleGeneration.ref();
+            zoomSize = QSize();
+            tileSourceSent = false;
             staticImage->crop(newRect);
             updateInfoString();
-            emit imageAltered(currentImage()->getPixmap());
+            emit imageAltered(currentImage()->sharedImage());
         }
-        else if ((currentVideo = dynamic_cast<Video *>(currentImage())) != NULL) {
+        else if((currentVideo = qSharedPointerDynamicCast<Video>(currentImage()))) {
             currentVideo->crop(newRect);
             updateInfoString();
             emit videoAltered(currentVideo->getClip());
@@ -262,3 +403,47 @@ void Core::crop(QRect newRect) {
     }
 
 }
+
+void Core::onFileAdded(int pos) {
+    if(currentImagePos >= pos) {
+        currentImagePos++;
+    }
+    emit fileAdded(pos);
+    updateInfoString();
+}
+
+void Core::onFileListChanged(QVector<int> moved, int pos) {
+    bool lost = (currentImagePos != -1 && pos == -1);
+    currentImagePos = pos;
+    emit fileListReordered(moved, cache->length());
+    if(currentImagePos != -1) {
+        emit imageChanged(currentImagePos);
+    } else if(lost) {
+        replaceLostImage();
+    }
+    updateInfoString();
+}
+
+void Core::onFileRemoved(int pos) {
+    emit fileRemoved(pos);
+    if(currentImagePos > pos) {
+        currentImagePos--;
+    } else if(currentImagePos == pos) {
+        currentImagePos = -1;
+        replaceLostImage();
+    }
+    updateInfoString();
+}
+
+// displayed file is gone from the directory
+void Core::replaceLostImage() {
+    currentImageAnimated.clear();
+    currentVideo.clear();
+    showingPreview = false;
+    scaleGeneration.ref();
+    if(dirManager->containsImages()) {
+        imageLoader->open(dirManager->currentFilePos());
+    } else {
+        emit signalUnsetImage();
+    }
+}
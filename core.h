@@ -9,6 +9,7 @@
 #include "newloader.h"
 #include "settings.h"
 #include "sourceContainers/imageanimated.h"
+#include "sourceContainers/imagestatic.h"
 #include "wallpapersetter.h"
 #include "lib/stuff.h"
 #include <time.h>
@@ -55,10 +56,13 @@ public slots:
     // then sets it as wallpaper
     void setWallpaper(QRect wpRect);
 
-    // TODO: move to another thread
     // makes a scaled copy of current image
-    // and emits imageAltered(QPixmap*)
+    // and emits scalingFinished(QImage).
+    // Static images are scaled in background
     void rescaleForZoom(QSize newSize);
+    // emits sourceImageReady() with the full resolution image
+    // for tiled rendering, or a null image if there is none
+    void requestSourceImage();
     void startAnimation();
     void stopAnimation();
 
@@ -66,34 +70,68 @@ private:
     NewLoader *imageLoader;
     DirectoryManager *dirManager;
     int currentImagePos;
-    ImageAnimated* currentImageAnimated;
-    Video* currentVideo;
+    // hold their image alive while it is displayed
+    QSharedPointer<ImageAnimated> currentImageAnimated;
+    QSharedPointer<Video> currentVideo;
     QMutex mutex;
     ImageCache *cache;
+    // viewer shows a preview, currentImage() is not what is on screen
+    bool showingPreview;
+    // bumped by each rescale request and each image change;
+    // results of older rescales are dropped, unfinished ones give up
+    QAtomicInt scaleGeneration;
+    // last zoom request and whether the viewer renders tiles from us;
+    // both are redone once the full resolution decode arrives
+    QSize zoomSize;
+    bool tileSourceSent;
+    // file being decoded at full resolution in background
+    QString fullDecodePath;
+    void replaceLostImage();
+    void startFullDecode();
+
+    // runs in a pool thread
+    void scaleInBackground(QSharedPointer<ImagePyramid> pyramid, QSize newSize,
+                           Resampler::Filter filter, int generation);
+    // runs in a pool thread
+    void decodeFullResolution(QSharedPointer<Image> img);
 
     void initVariables();
     void connectSlots();
-    Image* currentImage();
+    QSharedPointer<Image> currentImage();
 
 private slots:
     void onLoadStarted();
 
     // displays image and starts animation/video playback
-    void onLoadFinished(Image *img, int pos);
+    void onLoadFinished(QSharedPointer<Image> img, int pos);
+    void onPreviewReady(QImage preview, QSize realSize, int pos);
     void crop(QRect newRect);
+    void onScalingFinished(QImage scaled, int generation);
+    void onFullResolutionReady(QString path);
+    void onFileAdded(int pos);
+    // opens the next file if the current one is gone
+    void onFileRemoved(int pos);
+    void onFileListChanged(QVector<int> moved, int pos);
 
 signals:
     void signalUnsetImage();
-    void signalSetImage(QPixmap*);
+    // image may be a reduced copy; QSize is the real image size
+    void signalSetImage(QImage, QSize);
     void infoStringChanged(QString);
     void slowLoading();
-    void imageAltered(QPixmap*);
+    void imageAltered(QImage);
     void videoAltered(Clip*);
-    void scalingFinished(QPixmap*);
-    void frameChanged(QPixmap*);
+    void scalingFinished(QImage);
+    void sourceImageReady(QImage);
+    void frameChanged(QImage);
     void thumbnailRequested(int);
+    void thumbnailRangeChanged(int, int);
     void thumbnailReady(int, Thumbnail*);
     void cacheInitialized(int);
+    void fileAdded(int);
+    void fileRemoved(int);
+    // same files, new order; see NewLoader::fileListChanged()
+    void fileListReordered(QVector<int>, int count);
     void imageChanged(int);
     void startVideo();
     void stopVideo();
@@ -4,8 +4,29 @@ DirectoryManager::DirectoryManager() :
     currentPos(-1),
     startDir(""),
     infiniteScrolling(false),
-    quickFormatDetection(true)
+    quickFormatDetection(true),
+    sortingMode(-1),
+    listedSortingMode(-1)
 {
+    watcher = new QFileSystemWatcher(this);
+    rescanTimer = new QTimer(this);
+    rescanTimer->setSingleShot(true);
+    connect(watcher, SIGNAL(directoryChanged(QString)),
+            this, SLOT(onDirectoryModified()));
+    connect(rescanTimer, SIGNAL(timeout()), this, SLOT(rescan()));
+    backgroundPool = new QThreadPool(this);
+    backgroundPool->setMaxThreadCount(qMax(1, QThread::idealThreadCount() / 2));
+    scanWatcher = new QFutureWatcher<FileFormat>(this);
+    connect(scanWatcher, SIGNAL(resultsReadyAt(int, int)),
+            this, SLOT(onScanResults(int, int)));
+    connect(scanWatcher, SIGNAL(finished()), this, SLOT(onScanFinished()));
+    listWatcher = new QFutureWatcher<QList<FileEntry> >(this);
+    connect(listWatcher, SIGNAL(finished()), this, SLOT(onListingFinished()));
+    rescanWatcher = new QFutureWatcher<QList<FileEntry> >(this);
+    connect(rescanWatcher, SIGNAL(finished()), this, SLOT(onRescanFinished()));
+    metadataIndex = new MetadataIndex(backgroundPool, this);
+    connect(metadataIndex, SIGNAL(finished()), this, SLOT(onMetadataIndexed()));
+    connect(qApp, SIGNAL(aboutToQuit()), this, SLOT(onQuit()));
     readSettings();
     setCurrentDir(startDir);
     connect(settings, SIGNAL(settingsChanged()), this, SLOT(applySettingsChanges()));
@@ -26,9 +47,38 @@ void DirectoryManager::readSettings() {
 }
 
 void DirectoryManager::setFile(QString path) {
-    FileInfo *info = loadInfo(path);
-    setCurrentDir(info->directoryPath());
-    currentPos = fileNameList.indexOf(info->fileName());
+    QFileInfo info(path);
+    setCurrentDir(info.absolutePath());
+    // don't wait for the deep scan to reach it
+    if(scanWatcher->isRunning() && !fileNameList.contains(info.fileName())) {
+        for(int i = 0; i < scanEntries.count(); i++) {
+            if(scanEntries.at(i).name == info.fileName()) {
+                scanEntries[i].format = fileFormat(path);
+                if(mimeFilters.contains(scanEntries.at(i).format.mimeType)) {
+                    addScanned(i);
+                }
+                break;
+            }
+        }
+    }
+    // nor for the listing
+    if(listWatcher->isRunning() && !fileNameList.contains(info.fileName())) {
+        FileEntry entry(info);
+        if(quickFormatDetection) {
+            if(path == sniffedPath) {
+                entry.format = sniffed;
+            }
+            if(QDir::match(extensionFilters, info.fileName())) {
+                insertFile(fileNameList.count(), entry);
+            }
+        } else {
+            entry.format = fileFormat(path);
+            if(mimeFilters.contains(entry.format.mimeType)) {
+                insertFile(fileNameList.count(), entry);
+            }
+        }
+    }
+    currentPos = fileNameList.indexOf(info.fileName());
     settings->setLastFilePosition(currentPos);
 }
 
@@ -143,23 +193,18 @@ bool DirectoryManager::existsInCurrentDir(QString file) {
 }
 
 bool DirectoryManager::isImage(QString filePath) {
-    QFile file(filePath);
-    if(file.exists()) {
-        /* workaround
-         * webp is detected as "audio/x-riff"
-         * TODO: parse file header for this case
-         */
-        if(QString::compare(filePath.split('.').last(), "webp", Qt::CaseInsensitive) == 0) {
-            return true;
-        }
-        /* end */
+    return mimeFilters.contains(fileFormat(filePath).mimeType);
+}
 
-        QMimeType type = mimeDb.mimeTypeForFile(filePath, QMimeDatabase::MatchContent);
-        if(mimeFilters.contains(type.name())) {
-            return true;
-        }
+FileFormat DirectoryManager::formatAt(int pos) {
+    return entries.value(fileNameList.value(pos)).format;
+}
+
+bool DirectoryManager::metadataAt(int pos, ImageMetadata &metadata) {
+    if(pos < 0 || pos >= fileNameList.count()) {
+        return false;
     }
-    return false;
+    return metadataIndex->lookup(fileNameList.at(pos), metadata);
 }
 
 bool DirectoryManager::containsImages() {
@@ -172,25 +217,14 @@ bool DirectoryManager::containsImages() {
 
 void DirectoryManager::applySettingsChanges() {
     infiniteScrolling = settings->infiniteScrolling();
-    QDir::SortFlags flags;
-    switch(settings->sortingMode()) {
-        case 1:
-            flags = QDir::SortFlags(QDir::Name | QDir::Reversed | QDir::IgnoreCase);
-            break;
-        case 2:
-            flags = QDir::SortFlags(QDir::Time);
-            break;
-        case 3:
-            flags = QDir::SortFlags(QDir::Time | QDir::Reversed);
-            break;
-        default:
-            flags = QDir::SortFlags(QDir::Name | QDir::IgnoreCase);
-            break;
-    }
-    if(currentDir.sorting() != flags) {
-        currentDir.setSorting(flags);
-        generateFileList();
-        emit directorySortingChanged(); //for now, sorting dir will cause full cache reload TODO
+    int mode = settings->sortingMode();
+    if(mode == sortingMode) {
+        return;
+    }
+    sortingMode = mode;
+    // unfinished lists are sorted once they are done
+    if(!scanWatcher->isRunning() && !listWatcher->isRunning() && sortFileList()) {
+        emit fileListChanged();
     }
 }
 
@@ -206,56 +240,445 @@ void DirectoryManager::changePath(QString path) {
         qDebug() << "DirManager: Invalid directory specified. Removing setting.";
         settings->setLastDirectory("");
     }
+    fileNameList.clear();
+    entries.clear();
     generateFileList();
     currentPos = -1;
+    watch(currentDir.absolutePath());
     emit directoryChanged(path);
 }
 
-FileInfo *DirectoryManager::loadInfo(QString path) {
-    FileInfo *info = new FileInfo(path);
-    return info;
+void DirectoryManager::watch(QString path) {
+    rescanTimer->stop();
+    if(!watcher->directories().isEmpty()) {
+        watcher->removePaths(watcher->directories());
+    }
+    if(currentDir.isReadable()) {
+        watcher->addPath(path);
+    }
 }
 
-void DirectoryManager::generateFileList() {
-    switch(settings->sortingMode()) {
-        case 1:
-            currentDir.setSorting(QDir::Name | QDir::Reversed | QDir::IgnoreCase);
-            quickFormatDetection ? generateFileListQuick() : generateFileListDeep();
-            break;
-        case 2:
-            currentDir.setSorting(QDir::Time);
-            quickFormatDetection ? generateFileListQuick() : generateFileListDeep();
-            break;
-        case 3:
-            currentDir.setSorting(QDir::Time | QDir::Reversed);
-            quickFormatDetection ? generateFileListQuick() : generateFileListDeep();
-            break;
-        default:
-            currentDir.setSorting(QDir::Name | QDir::IgnoreCase);
-            quickFormatDetection ? generateFileListQuick() : generateFileListDeep();
-            break;
+// the current file stays current
+bool DirectoryManager::sortFileList() {
+    QList<FileEntry> list;
+    list.reserve(fileNameList.count());
+    for(int i = 0; i < fileNameList.count(); i++) {
+        list.append(entries.value(fileNameList.at(i)));
+    }
+    FileEntry::sort(list, sortingMode);
+    QString current = fileNameList.value(currentPos);
+    bool changed = false;
+    for(int i = 0; i < list.count(); i++) {
+        if(fileNameList.at(i) != list.at(i).name) {
+            fileNameList[i] = list.at(i).name;
+            changed = true;
+        }
+        if(list.at(i).name == current) {
+            currentPos = i;
+        }
+    }
+    return changed;
+}
+
+void DirectoryManager::insertFile(int pos, const FileEntry &entry) {
+    fileNameList.insert(pos, entry.name);
+    entries.insert(entry.name, entry);
+    if(pos <= currentPos) {
+        currentPos++;
+    }
+    emit fileAdded(pos);
+}
+
+// if the current file is removed, the one that took its place becomes current
+void DirectoryManager::removeFile(int pos) {
+    entries.remove(fileNameList.takeAt(pos));
+    if(pos < currentPos || currentPos >= fileNameList.count()) {
+        currentPos--;
+    }
+    emit fileRemoved(pos);
+}
+
+FileFormat DirectoryManager::fileFormat(QString filePath) {
+    QFileInfo info(filePath);
+    if(info.absolutePath() == currentDir.absolutePath()) {
+        QHash<QString, FileEntry>::iterator entry = entries.find(info.fileName());
+        if(entry != entries.end()) {
+            if(entry->format.isNull()) {
+                entry->format = FormatSniffer::formatForFile(filePath);
+            }
+            return entry->format;
+        }
+    }
+    if(filePath != sniffedPath) {
+        sniffedPath = filePath;
+        sniffed = FormatSniffer::formatForFile(filePath);
     }
+    return sniffed;
+}
+
+bool DirectoryManager::indexMetadata() {
+    QList<FileEntry> files;
+    files.reserve(fileNameList.count());
+    for(int i = 0; i < fileNameList.count(); i++) {
+        files.append(entries.value(fileNameList.at(i)));
+    }
+    bool complete = metadataIndex->update(currentDir.absolutePath(), files);
+    for(QHash<QString, FileEntry>::iterator i = entries.begin(); i != entries.end(); ++i) {
+        fillFromIndex(*i);
+    }
+    return complete;
+}
+
+// records that were never sniffed take the format from the index
+void DirectoryManager::fillFromIndex(FileEntry &entry) {
+    ImageMetadata indexed;
+    if(!metadataIndex->lookup(entry.name, indexed) ||
+       indexed.modified != entry.modified || indexed.fileSize != entry.size)
+    {
+        return;
+    }
+    if(entry.format.isNull()) {
+        entry.format = indexed.format();
+    }
+    entry.dateTaken = indexed.dateTaken;
+    entry.pixels = (qint64)indexed.size.width() * indexed.size.height();
+}
+
+void DirectoryManager::keepFormat(FileEntry &entry) {
+    QHash<QString, FileEntry>::iterator old = entries.find(entry.name);
+    if(old != entries.end() && old->modified == entry.modified) {
+        entry.format = old->format;
+    }
+}
+
+void DirectoryManager::generateFileList() {
+    quickFormatDetection ? generateFileListQuick() : generateFileListDeep();
+}
+
+// Reads the directory as a stream (QDirIterator) instead of
+// QDir::entryList() and sorts the records. Runs in backgroundPool.
+static QList<FileEntry> listDirectory(QString dirPath, QStringList nameFilters, int sortingMode) {
+    QThread::currentThread()->setPriority(QThread::LowPriority);
+    QList<FileEntry> list = FileEntry::readDirectory(dirPath, nameFilters);
+    FileEntry::sort(list, sortingMode);
+    return list;
 }
 
 // Filter by file extension, fast.
 // Files with unsupported extension are ignored.
 // Additionally there is a mime type check on image load (FileInfo::guessType()).
 // For example an .exe wont open, but a gif with .jpg extension will still play.
+// Runs in background, see listDirectory().
 void DirectoryManager::generateFileListQuick() {
     currentDir.setNameFilters(extensionFilters);
-    fileNameList = currentDir.entryList();
+    listedSortingMode = sortingMode;
+    listWatcher->setFuture(QtConcurrent::run(backgroundPool, listDirectory,
+                                             currentDir.absolutePath(),
+                                             extensionFilters,
+                                             sortingMode));
+}
+
+// Files matching nameFilters. Unless mimeFilters is empty, files that
+// are not in known are sniffed and dropped if they don't match.
+// Runs in backgroundPool
+static QList<FileEntry> rescanDirectory(QString dirPath, QStringList nameFilters,
+                                        QSet<QString> known, QStringList mimeFilters)
+{
+    QList<FileEntry> list = FileEntry::readDirectory(dirPath, nameFilters);
+    if(mimeFilters.isEmpty()) {
+        return list;
+    }
+    QList<FileEntry> filtered;
+    for(int i = 0; i < list.count(); i++) {
+        FileEntry entry = list.at(i);
+        if(!known.contains(entry.name)) {
+            entry.format = FormatSniffer::formatForFile(dirPath + "/" + entry.name);
+            if(!mimeFilters.contains(entry.format.mimeType)) {
+                continue;
+            }
+        }
+        filtered.append(entry);
+    }
+    return filtered;
 }
 
-// Filter by mime type. Basically opens every file in a folder
-// and checks what's inside. Very slow.
+// one deep scan sniff, runs in backgroundPool
+struct DeepScanTest {
+    DeepScanTest(QString _dirPath) : dirPath(_dirPath) {
+    }
+    typedef FileFormat result_type;
+    FileFormat operator()(const FileEntry &entry) {
+        return FormatSniffer::formatForFile(dirPath + "/" + entry.name);
+    }
+    QString dirPath;
+};
+
+// Filter by mime type. Opens every file in a folder and checks
+// what's inside, so it runs in background. The directory is listed
+// like in quick mode, then the files are sniffed (startDeepScan()).
+// Until then only the file passed to setFile() is listed
 void DirectoryManager::generateFileListDeep() {
+    scanWatcher->cancel();
     currentDir.setNameFilters(QStringList("*"));
+    scanEntries.clear();
+    scanIndex.clear();
+    listedSortingMode = sortingMode;
+    listWatcher->setFuture(QtConcurrent::run(backgroundPool, listDirectory,
+                                             currentDir.absolutePath(),
+                                             QStringList("*"),
+                                             sortingMode));
+}
+
+// files already in fileNameList (opened during the listing) are kept
+void DirectoryManager::startDeepScan(const QList<FileEntry> &list) {
+    scanEntries = list;
+    QHash<QString, int> listed;
+    listed.reserve(scanEntries.count());
+    for(int i = 0; i < scanEntries.count(); i++) {
+        listed.insert(scanEntries.at(i).name, i);
+    }
+    for(int i = fileNameList.count() - 1; i >= 0; i--) {
+        if(!listed.contains(fileNameList.at(i))) {
+            removeFile(i);
+        }
+    }
+    // in listing order
+    QMap<int, QString> known;
+    for(int i = 0; i < fileNameList.count(); i++) {
+        int index = listed.value(fileNameList.at(i));
+        scanEntries[index].format = entries.value(fileNameList.at(i)).format;
+        known.insert(index, fileNameList.at(i));
+    }
+    scanIndex = known.keys().toVector();
+    if(known.values() != fileNameList) {
+        QString current = fileNameList.value(currentPos);
+        fileNameList = known.values();
+        currentPos = fileNameList.indexOf(current);
+        emit fileListChanged();
+    }
+    scanWatcher->setFuture(mappedOnPool(backgroundPool, scanEntries,
+                                        DeepScanTest(currentDir.absolutePath()),
+                                        SCAN_CHUNK));
+}
+
+// keeps fileNameList in the order of the directory listing
+void DirectoryManager::addScanned(int entry) {
+    int pos = std::lower_bound(scanIndex.begin(), scanIndex.end(), entry) - scanIndex.begin();
+    if(pos < scanIndex.count() && scanIndex.at(pos) == entry) {
+        return;
+    }
+    scanIndex.insert(pos, entry);
+    insertFile(pos, scanEntries.at(entry));
+}
+
+// ##############################################################
+// ###################### PRIVATE SLOTS #########################
+// ##############################################################
+
+void DirectoryManager::onDirectoryModified() {
+    rescanTimer->start(RESCAN_DELAY);
+}
+
+void DirectoryManager::rescan() {
+    // the scan would add the same files again
+    if(scanWatcher->isRunning() || listWatcher->isRunning() || rescanWatcher->isRunning()) {
+        rescanTimer->start(RESCAN_DELAY);
+        return;
+    }
+    rescannedDir = currentDir.absolutePath();
+    if(quickFormatDetection) {
+        rescanWatcher->setFuture(QtConcurrent::run(backgroundPool, rescanDirectory,
+                                                   rescannedDir, extensionFilters,
+                                                   QSet<QString>(), QStringList()));
+    } else {
+        rescanWatcher->setFuture(QtConcurrent::run(backgroundPool, rescanDirectory,
+                                                   rescannedDir, QStringList("*"),
+                                                   QSet<QString>::fromList(fileNameList),
+                                                   mimeFilters));
+    }
+}
+
+// Renamed files show up as removed + added.
+// Files that only moved because of the sorting (modified, when sorted by time)
+// are reordered as a whole, so their loaded images are kept.
+// Many new files at once are published with a single fileListChanged()
+void DirectoryManager::onRescanFinished() {
+    // directory changed meanwhile, or the list is being rebuilt
+    if(rescannedDir != currentDir.absolutePath() ||
+       scanWatcher->isRunning() || listWatcher->isRunning())
+    {
+        return;
+    }
+    QList<FileEntry> newList = rescanWatcher->result();
+    for(int i = newList.count() - 1; i >= 0; i--) {
+        // known when the rescan started, but removed since; not sniffed
+        if(!quickFormatDetection && newList.at(i).format.isNull() &&
+           !entries.contains(newList.at(i).name))
+        {
+            newList.removeAt(i);
+        }
+    }
+    for(int i = 0; i < newList.count(); i++) {
+        keepFormat(newList[i]);
+        fillFromIndex(newList[i]);
+    }
+    FileEntry::sort(newList, sortingMode);
+    QSet<QString> present, added;
+    for(int i = 0; i < newList.count(); i++) {
+        present.insert(newList.at(i).name);
+        if(!entries.contains(newList.at(i).name)) {
+            added.insert(newList.at(i).name);
+        }
+    }
+    for(int i = fileNameList.count() - 1; i >= 0; i--) {
+        if(!present.contains(fileNameList.at(i))) {
+            removeFile(i);
+        }
+    }
+    // files that are still there may sort differently now
+    for(int i = 0; i < newList.count(); i++) {
+        if(!added.contains(newList.at(i).name)) {
+            entries.insert(newList.at(i).name, newList.at(i));
+        }
+    }
+    if(added.count() > 1) {
+        for(int i = 0; i < newList.count(); i++) {
+            if(added.contains(newList.at(i).name)) {
+                fileNameList.append(newList.at(i).name);
+                entries.insert(newList.at(i).name, newList.at(i));
+            }
+        }
+        sortFileList();
+        emit fileListChanged();
+    } else {
+        if(sortFileList()) {
+            emit fileListChanged();
+        }
+        // fileNameList is now in the order of newList without the new file
+        for(int i = 0; i < newList.count(); i++) {
+            if(added.contains(newList.at(i).name)) {
+                insertFile(i, newList.at(i));
+            }
+        }
+    }
+    indexMetadata();
+}
+
+// files found in a batch of results are merged into fileNameList
+// and published at once
+void DirectoryManager::onScanResults(int begin, int end) {
+    if(scanWatcher->isCanceled()) {
+        return;
+    }
+    QVector<int> found;
+    for(int i = begin; i < end; i++) {
+        FileFormat format = scanWatcher->resultAt(i);
+        if(mimeFilters.contains(format.mimeType) && !entries.contains(scanEntries.at(i).name)) {
+            scanEntries[i].format = format;
+            found.append(i);
+        }
+    }
+    if(found.isEmpty()) {
+        return;
+    }
+    // both are in listing order
+    QString current = fileNameList.value(currentPos);
+    QStringList names;
+    QVector<int> index;
+    names.reserve(fileNameList.count() + found.count());
+    index.reserve(fileNameList.count() + found.count());
+    int a = 0, b = 0;
+    while(a < scanIndex.count() || b < found.count()) {
+        if(b == found.count() || (a < scanIndex.count() && scanIndex.at(a) < found.at(b))) {
+            names.append(fileNameList.at(a));
+            index.append(scanIndex.at(a));
+            a++;
+        } else {
+            const FileEntry &entry = scanEntries.at(found.at(b));
+            names.append(entry.name);
+            entries.insert(entry.name, entry);
+            index.append(found.at(b));
+            b++;
+        }
+    }
+    fileNameList = names;
+    scanIndex = index;
+    if(!current.isEmpty()) {
+        currentPos = fileNameList.indexOf(current);
+    }
+    emit fileListChanged();
+}
+
+void DirectoryManager::onScanFinished() {
+    if(scanWatcher->isCanceled()) {
+        return;
+    }
+    scanEntries.clear();
+    scanIndex.clear();
+    indexMetadata();
+    // sorting mode may have changed during the scan
+    if(sortFileList()) {
+        emit fileListChanged();
+    }
+}
+
+// the opened file keeps being current
+void DirectoryManager::onListingFinished() {
+    QString current = fileNameList.value(currentPos);
+    QList<FileEntry> list = listWatcher->result();
+    if(!quickFormatDetection) {
+        startDeepScan(list);
+        return;
+    }
+    for(int i = 0; i < list.count(); i++) {
+        keepFormat(list[i]);
+    }
     fileNameList.clear();
-    QStringList unfiltered = currentDir.entryList();
-    for(int i = 0; i < unfiltered.count(); i++) {
-        QString filePath = currentDir.absolutePath() + "/" + unfiltered.at(i);
-        if(isImage(filePath)) {
-            fileNameList.append(unfiltered.at(i));
+    entries.clear();
+    fileNameList.reserve(list.count());
+    entries.reserve(list.count());
+    for(int i = 0; i < list.count(); i++) {
+        fileNameList.append(list.at(i).name);
+        entries.insert(list.at(i).name, list.at(i));
+    }
+    if(!current.isEmpty()) {
+        int oldPos = currentPos;
+        currentPos = fileNameList.indexOf(current);
+        // deleted meanwhile; same as removeFile()
+        if(currentPos == -1 && !fileNameList.isEmpty()) {
+            currentPos = qMin(oldPos, fileNameList.count() - 1);
         }
+    } else {
+        currentPos = -1;
     }
+    // the pool thread had no metadata to sort by,
+    // or sorting mode was changed meanwhile
+    indexMetadata();
+    if(FileEntry::usesMetadata(sortingMode) || listedSortingMode != sortingMode) {
+        sortFileList();
+    }
+    if(currentPos != -1) {
+        settings->setLastFilePosition(currentPos);
+    }
+    emit fileListChanged();
+}
+
+// files that were not indexed yet may have to move
+void DirectoryManager::onMetadataIndexed() {
+    for(QHash<QString, FileEntry>::iterator i = entries.begin(); i != entries.end(); ++i) {
+        fillFromIndex(*i);
+    }
+    if(FileEntry::usesMetadata(sortingMode) && sortFileList()) {
+        emit fileListChanged();
+    }
+    emit metadataIndexed();
+}
+
+// the listing itself can't be interrupted, the rest stops after the
+// file each thread is reading
+void DirectoryManager::onQuit() {
+    scanWatcher->cancel();
+    metadataIndex->stop();
+    backgroundPool->waitForDone();
+    metadataIndex->save();
 }
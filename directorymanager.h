@@ -4,7 +4,6 @@
 #include <QObject>
 #include <QMimeDatabase>
 #include <QDir>
-#include <QCollator>
 #include <algorithm>
 #include <vector>
 #include <QElapsedTimer>
@@ -16,8 +15,21 @@
 #include <QFileInfo>
 #include <QMessageBox>
 #include <QImageReader>
+#include <QFileSystemWatcher>
+#include <QTimer>
+#include <QSet>
+#include <QFutureWatcher>
+#include <QtConcurrent>
+#include <QThreadPool>
+#include <QCoreApplication>
+#include <QDirIterator>
+#include <QDateTime>
 #include "fileinfo.h"
 #include "settings.h"
+#include "formatsniffer.h"
+#include "fileentry.h"
+#include "metadataindex.h"
+#include "lib/poolmap.h"
 
 class DirectoryManager : public QObject
 {
@@ -55,7 +67,13 @@ public:
     int peekNext(int offset);
     int peekPrev(int offset);
     bool existsInCurrentDir(QString file);
+    // sniffs the file once, the result is kept in its record
     bool isImage(QString filePath);
+    // format from the record, null if the file was not sniffed yet.
+    // Does not touch the disk
+    FileFormat formatAt(int pos);
+    // header data from the metadata index; false if not indexed yet
+    bool metadataAt(int pos, ImageMetadata &metadata);
     bool containsImages();
 
 public slots:
@@ -64,18 +82,87 @@ public slots:
 private:
     QString startDir;
     bool infiniteScrolling;
-    QMimeDatabase mimeDb;
     bool quickFormatDetection;
+    int sortingMode;
+    // record of every file in fileNameList
+    QHash<QString, FileEntry> entries;
+    // last file sniffed outside of the list; a file from another
+    // directory is checked before setFile() creates its record
+    QString sniffedPath;
+    FileFormat sniffed;
+    FileFormat fileFormat(QString filePath);
+    // copies the format from the old record unless the file was modified
+    void keepFormat(FileEntry &entry);
+    // sorting fields (and the format, if not sniffed) from the metadata index
+    void fillFromIndex(FileEntry &entry);
+    QFileSystemWatcher *watcher;
+    // bursts of changes are applied at once
+    QTimer *rescanTimer;
+    const int RESCAN_DELAY = 300;
+
+    // listing, deep scan and metadata index run here instead of
+    // the global pool, which the viewer uses for scaling and tiles
+    QThreadPool *backgroundPool;
+
+    // deep scan checks files in backgroundPool.
+    // Entries are added to fileNameList in batches as they are found
+    QFutureWatcher<FileFormat> *scanWatcher;
+    const int SCAN_CHUNK = 128;
+    QList<FileEntry> scanEntries;
+    // index in scanEntries of every fileNameList item while scanning
+    QVector<int> scanIndex;
+    void addScanned(int entry);
+    // sniffs the listed files, the deep mode part after the listing
+    void startDeepScan(const QList<FileEntry> &list);
+
+    // both modes list the directory in a pool thread.
+    // Until it is done fileNameList holds only the file passed to setFile()
+    QFutureWatcher<QList<FileEntry> > *listWatcher;
+    // sorting mode the running listing uses
+    int listedSortingMode;
+
+    // rescans list (and in deep mode sniff new files) in backgroundPool
+    QFutureWatcher<QList<FileEntry> > *rescanWatcher;
+    QString rescannedDir;
+
+    MetadataIndex *metadataIndex;
+    // brings the index up to date with fileNameList.
+    // Returns true if it already was
+    bool indexMetadata();
 
     void changePath(QString path);
-    FileInfo* loadInfo(QString path);
     void generateFileList();
     void generateFileListQuick();
     void generateFileListDeep();
+    void watch(QString path);
+    // fileNameList in the current sorting mode. Returns true if the order changed
+    bool sortFileList();
+    void insertFile(int pos, const FileEntry &entry);
+    void removeFile(int pos);
+
+private slots:
+    void onDirectoryModified();
+    // lists the directory again after a change;
+    // onRescanFinished() updates fileNameList to match it
+    void rescan();
+    void onRescanFinished();
+    void onScanResults(int begin, int end);
+    void onScanFinished();
+    void onListingFinished();
+    void onMetadataIndexed();
+    // cancels the background jobs, keeping what the index has read
+    void onQuit();
 
 signals:
     void directoryChanged(const QString &path);
-    void directorySortingChanged();
+    // single file appeared in or disappeared from the current directory.
+    // pos is valid in the list right after the change
+    void fileAdded(int pos);
+    void fileRemoved(int pos);
+    // fileNameList was replaced as a whole
+    void fileListChanged();
+    // metadata of every listed file is available
+    void metadataIndexed();
 };
 
 #endif // DIRECTORYMANAGER_H
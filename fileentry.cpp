@@ -0,0 +1,122 @@
+#include "fileentry.h"
+
+FileEntry::FileEntry() : size(0), pixels(0) {
+}
+
+FileEntry::FileEntry(const QFileInfo &info)
+    : name(info.fileName()),
+      sortKey(naturalKey(info.fileName())),
+      modified(info.lastModified()),
+      size(info.size()),
+      pixels(0)
+{
+}
+
+bool FileEntry::usesMetadata(int mode) {
+    return mode >= 4 && mode <= 7;
+}
+
+void FileEntry::sort(QList<FileEntry> &list, int mode) {
+    // Names are compared in the order of the current locale. Collation keys
+    // are made once per sort; the collator is not shared because sorting
+    // also runs on pool threads
+    QCollator collator;
+    collator.setCaseSensitivity(Qt::CaseInsensitive);
+    std::vector<QCollatorSortKey> keys;
+    keys.reserve(list.count());
+    std::vector<int> order;
+    order.reserve(list.count());
+    for(int i = 0; i < list.count(); i++) {
+        keys.push_back(collator.sortKey(list.at(i).sortKey));
+        order.push_back(i);
+    }
+    // ties are broken by the name so that reversing gives the exact opposite
+    auto byName = [&](int a, int b) {
+        int result = keys[a].compare(keys[b]);
+        if(result != 0) {
+            return result < 0;
+        }
+        return list.at(a).name < list.at(b).name;
+    };
+    if(mode == 4 || mode == 5) {
+        // newest first like mode 2; files without EXIF date go by mtime
+        std::sort(order.begin(), order.end(), [&](int a, int b) {
+            const FileEntry &entryA = list.at(a), &entryB = list.at(b);
+            const QDateTime &dateA = entryA.dateTaken.isValid() ? entryA.dateTaken : entryA.modified;
+            const QDateTime &dateB = entryB.dateTaken.isValid() ? entryB.dateTaken : entryB.modified;
+            if(dateA != dateB) {
+                return dateA > dateB;
+            }
+            return byName(a, b);
+        });
+    } else if(mode == 6 || mode == 7) {
+        // smallest first
+        std::sort(order.begin(), order.end(), [&](int a, int b) {
+            if(list.at(a).pixels != list.at(b).pixels) {
+                return list.at(a).pixels < list.at(b).pixels;
+            }
+            return byName(a, b);
+        });
+    } else if(mode == 2 || mode == 3) {
+        // newest first
+        std::sort(order.begin(), order.end(), [&](int a, int b) {
+            if(list.at(a).modified != list.at(b).modified) {
+                return list.at(a).modified > list.at(b).modified;
+            }
+            return byName(a, b);
+        });
+    } else {
+        std::sort(order.begin(), order.end(), byName);
+    }
+    if(mode == 1 || mode == 3 || mode == 5 || mode == 7) {
+        std::reverse(order.begin(), order.end());
+    }
+    QList<FileEntry> sorted;
+    sorted.reserve(list.count());
+    for(unsigned int i = 0; i < order.size(); i++) {
+        sorted.append(list.at(order[i]));
+    }
+    list.swap(sorted);
+}
+
+QList<FileEntry> FileEntry::readDirectory(QString path, QStringList nameFilters) {
+    QList<FileEntry> list;
+    QDirIterator it(path, nameFilters, QDir::Files);
+    while(it.hasNext()) {
+        it.next();
+        list.append(FileEntry(it.fileInfo()));
+    }
+    return list;
+}
+
+// every run of digits is padded to NUMBER_WIDTH, so collating
+// the keys orders numbers by value without the collator's numeric
+// mode, which the non-ICU backends ignore
+QString FileEntry::naturalKey(const QString &name) {
+    QString folded = name.toCaseFolded();
+    QString key;
+    key.reserve(folded.length() + NUMBER_WIDTH);
+    int i = 0;
+    while(i < folded.length()) {
+        QChar c = folded.at(i);
+        if(c < '0' || c > '9') {
+            key.append(c);
+            i++;
+            continue;
+        }
+        int start = i;
+        while(i < folded.length() && folded.at(i) >= '0' && folded.at(i) <= '9') {
+            i++;
+        }
+        // leading zeros don't count
+        while(start < i - 1 && folded.at(start) == '0') {
+            start++;
+        }
+        int length = i - start;
+        if(length < NUMBER_WIDTH) {
+            key.append(QString(NUMBER_WIDTH - length, '0'));
+        }
+        key.append(folded.midRef(start, length));
+    }
+    return key;
+}
@@ -0,0 +1,47 @@
+#ifndef FILEENTRY_H
+#define FILEENTRY_H
+
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include <QDateTime>
+#include <QFileInfo>
+#include <QDirIterator>
+#include <QCollator>
+#include <algorithm>
+#include <vector>
+#include "formatsniffer.h"
+
+// One file of the directory list.
+// Everything the sorting needs is read once, so changing the order
+// is a sort of these records and does not touch the disk.
+class FileEntry {
+public:
+    FileEntry();
+    FileEntry(const QFileInfo &info);
+
+    QString name;
+    // case folded name with numbers zero padded, "img2" < "img10".
+    // Collated in the current locale when sorting
+    QString sortKey;
+    QDateTime modified;
+    qint64 size;
+    // null until the file is sniffed
+    FileFormat format;
+    // from the metadata index; invalid / 0 while unknown
+    QDateTime dateTaken;
+    qint64 pixels;
+
+    // modes are the ones of Settings::sortingMode()
+    static void sort(QList<FileEntry> &list, int mode);
+    // sorting by this mode needs dateTaken or pixels
+    static bool usesMetadata(int mode);
+    // files matching nameFilters, unsorted. Can be used from any thread
+    static QList<FileEntry> readDirectory(QString path, QStringList nameFilters);
+
+private:
+    static QString naturalKey(const QString &name);
+    static const int NUMBER_WIDTH = 20;
+};
+
+#endif // FILEENTRY_H
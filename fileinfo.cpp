@@ -2,6 +2,16 @@
 
 FileInfo::FileInfo(QString path, QObject *parent) : QObject(parent), type(NONE), extension(NULL) {
     setFile(path);
+    if(fileInfo.isFile()) {
+        guessType();
+    }
+}
+
+FileInfo::FileInfo(QString path, const FileFormat &format, QObject *parent)
+    : QObject(parent), type(NONE), extension(NULL)
+{
+    setFile(path);
+    setFormat(format);
 }
 
 FileInfo::~FileInfo() {
@@ -50,14 +60,17 @@ void FileInfo::setFile(QString path) {
         return;
     }
     lastModified = fileInfo.lastModified();
-    guessType();
 }
 
 void FileInfo::guessType() {
-    QMimeDatabase mimeDb;
-    QMimeType mimeType = mimeDb.mimeTypeForFile(fileInfo.filePath(), QMimeDatabase::MatchContent);
-    QString mimeName = mimeType.name();
+    setFormat(FormatSniffer::formatForFile(fileInfo.filePath()));
+}
 
+// extension is the format name for QImageReader;
+// NULL lets the reader detect it by itself
+void FileInfo::setFormat(const FileFormat &format) {
+    QString mimeName = format.mimeType;
+    extension = NULL;
     if(mimeName == "video/webm") {
         extension = "webm";
         type = fileType::VIDEO;
@@ -70,24 +83,13 @@ void FileInfo::guessType() {
     } else if(mimeName == "image/gif") {
         extension = "gif";
         type = ANIMATED;
-    // webp is incorrectly(?) detected as audio/x-riff on my windows pc
-    } else if(mimeName == "audio/x-riff") {
-        // in case we encounter an actual audio/x-riff
-        if(QString::compare(filePath().split('.').last(), "webp", Qt::CaseInsensitive) == 0) {
-            extension = "webp";
-            type = ANIMATED;
-        }
-    // TODO: parse header to find out if it supports animation.
-    // treat all webp as animated for now.
     } else if(mimeName == "image/webp") {
         extension = "webp";
-        type = ANIMATED;
+        type = format.animated ? ANIMATED : STATIC;
     } else if(mimeName == "image/bmp") {
         extension = "bmp";
         type = STATIC;
     } else {
-        extension = ((QString)fileInfo.fileName().split('.').last()).toStdString().c_str();
         type = STATIC;
     }
-
 }
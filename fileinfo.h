@@ -4,12 +4,12 @@
 #include <QString>
 #include <QSize>
 #include <QUrl>
-#include <QMimeDatabase>
 #include <QDebug>
 #include <QFileInfo>
 #include <QDateTime>
 #include <cmath>
 #include "lib/stuff.h"
+#include "formatsniffer.h"
 
 enum fileType { NONE, STATIC, ANIMATED, VIDEO };
 
@@ -17,6 +17,8 @@ class FileInfo : public QObject
 {
 public:
     FileInfo(QString path, QObject *parent = 0);
+    // format is already known, the file is not read
+    FileInfo(QString path, const FileFormat &format, QObject *parent = 0);
     ~FileInfo();
     
     QString directoryPath();
@@ -42,6 +44,7 @@ private:
     // guesses file type from its contents
     // and sets extension
     void guessType();
+    void setFormat(const FileFormat &format);
 };
 
 #endif // FILEINFO_H
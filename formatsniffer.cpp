@@ -0,0 +1,57 @@
+#include "formatsniffer.h"
+
+QString FormatSniffer::mimeType(const QByteArray &header) {
+    if(header.startsWith("\xFF\xD8\xFF")) {
+        return "image/jpeg";
+    }
+    if(header.startsWith("\x89PNG\r\n\x1A\n")) {
+        return "image/png";
+    }
+    if(header.startsWith("GIF87a") || header.startsWith("GIF89a")) {
+        return "image/gif";
+    }
+    if(header.startsWith("RIFF") && header.mid(8, 4) == "WEBP") {
+        return "image/webp";
+    }
+    // EBML header; doctype follows within a few bytes
+    if(header.startsWith("\x1A\x45\xDF\xA3") && header.indexOf("webm") != -1) {
+        return "video/webm";
+    }
+    if(header.startsWith(QByteArray("II*\0", 4)) || header.startsWith(QByteArray("MM\0*", 4))) {
+        return "image/tiff";
+    }
+    if(header.startsWith(QByteArray("\0\0\1\0", 4))) {
+        return "image/vnd.microsoft.icon";
+    }
+    if(header.startsWith("BM") && header.size() >= 14) {
+        return "image/bmp";
+    }
+    return QString();
+}
+
+FileFormat FormatSniffer::format(const QByteArray &header) {
+    FileFormat format;
+    format.mimeType = mimeType(header);
+    if(format.mimeType.isEmpty()) {
+        // svg, xpm, pnm etc
+        QMimeDatabase mimeDb;
+        format.mimeType = mimeDb.mimeTypeForData(header).name();
+    } else if(format.mimeType == "image/gif") {
+        format.animated = true;
+    } else if(format.mimeType == "image/webp") {
+        // extended format: "VP8X", chunk size, then flags; bit 1 is animation
+        format.animated = header.mid(12, 4) == "VP8X" &&
+                          header.size() > 20 && (header.at(20) & 0x02);
+    }
+    return format;
+}
+
+FileFormat FormatSniffer::formatForFile(QString path) {
+    QFile file(path);
+    if(!file.open(QIODevice::ReadOnly)) {
+        return FileFormat();
+    }
+    QByteArray header = file.read(HEADER_SIZE);
+    file.close();
+    return format(header);
+}
@@ -0,0 +1,39 @@
+#ifndef FORMATSNIFFER_H
+#define FORMATSNIFFER_H
+
+#include <QString>
+#include <QByteArray>
+#include <QFile>
+#include <QMimeDatabase>
+
+// result of one sniff
+class FileFormat {
+public:
+    FileFormat() : animated(false) {
+    }
+    // empty if unknown or not sniffed yet
+    QString mimeType;
+    // gif, or webp with the animation flag set (VP8X chunk)
+    bool animated;
+
+    bool isNull() const {
+        return mimeType.isEmpty();
+    }
+};
+
+// Detects file formats from their first bytes.
+// Known signatures are checked directly; other files go to QMimeDatabase,
+// but only with the same few bytes, so a file is never read further.
+// Can be used from any thread.
+class FormatSniffer {
+public:
+    // mime type for a signature from the table, empty if none matches
+    static QString mimeType(const QByteArray &header);
+    static FileFormat format(const QByteArray &header);
+    // null if the file can not be read
+    static FileFormat formatForFile(QString path);
+
+    static const int HEADER_SIZE = 512;
+};
+
+#endif // FORMATSNIFFER_H
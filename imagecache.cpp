@@ -1,6 +1,12 @@
 #include "imagecache.h"
 
-ImageCache::ImageCache() {
+ImageCache::ImageCache() :
+    maxCacheSize(0),
+    accessTime(0),
+    hits(0),
+    misses(0),
+    evictions(0)
+{
     cachedImages = new QList<CacheObject *>();
     applySettings();
     connect(settings, SIGNAL(settingsChanged()),
@@ -18,11 +24,13 @@ ImageCache::~ImageCache() {
 void ImageCache::init(QString directory, QStringList list) {
     lock();
     dir = directory;
-    while(!cachedImages->isEmpty()) {
-        delete cachedImages->takeAt(0);
-    }
+    qDeleteAll(*cachedImages);
+    cachedImages->clear();
+    objects.clear();
     for(int i = 0; i < list.length(); i++) {
-        cachedImages->append(new CacheObject(list.at(i)));
+        CacheObject *obj = new CacheObject(list.at(i));
+        cachedImages->append(obj);
+        objects.insert(list.at(i), obj);
     }
     unlock();
     emit initialized(length());
@@ -37,18 +45,80 @@ void ImageCache::unloadAll() {
 }
 
 void ImageCache::unloadAt(int pos) {
+    lock();
     if(pos >= 0 && pos < cachedImages->length()) {
-        lock();
         cachedImages->at(pos)->unload();
-        unlock();
     }
+    unlock();
+}
+
+void ImageCache::insertAt(int pos, QString path) {
+    lock();
+    if(pos >= 0 && pos <= cachedImages->length() && !objects.contains(path)) {
+        CacheObject *obj = new CacheObject(path);
+        cachedImages->insert(pos, obj);
+        objects.insert(path, obj);
+    }
+    unlock();
+}
+
+void ImageCache::removeAt(int pos) {
+    lock();
+    if(pos >= 0 && pos < cachedImages->length()) {
+        CacheObject *obj = cachedImages->takeAt(pos);
+        objects.remove(obj->filePath());
+        delete obj;
+    }
+    unlock();
 }
 
-Image *ImageCache::imageAt(int pos) {
+// objects are looked up by path, only the order list is rebuilt
+QVector<int> ImageCache::reorder(QStringList list) {
+    lock();
+    for(int i = 0; i < cachedImages->count(); i++) {
+        cachedImages->at(i)->position = i;
+    }
+    QVector<int> moved(cachedImages->count(), -1);
+    QList<CacheObject*> order;
+    order.reserve(list.count());
+    for(int i = 0; i < list.count(); i++) {
+        CacheObject *obj = objects.value(list.at(i), NULL);
+        if(obj) {
+            moved[obj->position] = i;
+        } else {
+            obj = new CacheObject(list.at(i));
+            objects.insert(list.at(i), obj);
+        }
+        order.append(obj);
+    }
+    for(int i = 0; i < cachedImages->count(); i++) {
+        if(moved.at(i) == -1) {
+            objects.remove(cachedImages->at(i)->filePath());
+            delete cachedImages->at(i);
+        }
+    }
+    *cachedImages = order;
+    unlock();
+    return moved;
+}
+
+QSharedPointer<Image> ImageCache::imageAt(int pos) {
+    QSharedPointer<Image> img;
+    lock();
     if(pos >= 0 && pos < cachedImages->length())
-        return cachedImages->at(pos)->image();
-    else
-        return NULL;
+        img = cachedImages->at(pos)->image();
+    unlock();
+    return img;
+}
+
+QSharedPointer<Image> ImageCache::imageFor(QString path) {
+    QSharedPointer<Image> img;
+    lock();
+    CacheObject *obj = objects.value(path, NULL);
+    if(obj)
+        img = obj->image();
+    unlock();
+    return img;
 }
 
 int ImageCache::length() const {
@@ -61,17 +131,29 @@ QString ImageCache::currentDirectory() {
 }
 
 bool ImageCache::isLoaded(int pos) {
+    bool loaded = false;
+    lock();
     if(pos >= 0 && pos < cachedImages->length())
-        return cachedImages->at(pos)->isLoaded();
-    else
-        return false;
+        loaded = cachedImages->at(pos)->isLoaded();
+    unlock();
+    return loaded;
+}
+
+bool ImageCache::isLoaded(QString path) {
+    bool loaded = false;
+    lock();
+    CacheObject *obj = objects.value(path, NULL);
+    if(obj)
+        loaded = obj->isLoaded();
+    unlock();
+    return loaded;
 }
 
 int ImageCache::currentlyLoadedCount() {
     int x = 0;
     lock();
     for(int i = 0; i < cachedImages->length(); i++) {
-        if(isLoaded(i)) {
+        if(cachedImages->at(i)->isLoaded()) {
             x++;
         }
     }
@@ -80,8 +162,106 @@ int ImageCache::currentlyLoadedCount() {
 }
 
 void ImageCache::setImage(Image *img, int pos) {
-    if(pos >= 0 && pos < cachedImages->length())
-        cachedImages->at(pos)->setImage(img);
+    lock();
+    if(pos >= 0 && pos < cachedImages->length()) {
+        store(cachedImages->at(pos), img);
+    } else {
+        img->deleteLater();
+    }
+    unlock();
+}
+
+void ImageCache::setImage(Image *img, QString path) {
+    lock();
+    CacheObject *obj = objects.value(path, NULL);
+    if(obj) {
+        store(obj, img);
+    } else {
+        img->deleteLater();
+    }
+    unlock();
+}
+
+bool ImageCache::lookup(int pos) {
+    lock();
+    if(pos < 0 || pos >= cachedImages->length()) {
+        unlock();
+        return false;
+    }
+    bool loaded = cachedImages->at(pos)->isLoaded();
+    if(loaded) {
+        cachedImages->at(pos)->setAccessTime(++accessTime);
+        hits.ref();
+    } else {
+        misses.ref();
+    }
+    unlock();
+    return loaded;
+}
+
+// images loaded after the sizes were taken count as empty until the next call
+QList<int> ImageCache::shrink(int current) {
+    QList<int> unloaded;
+    QHash<Image*, qint64> sizes = imageSizes();
+    qint64 usage = 0;
+    for(QHash<Image*, qint64>::iterator i = sizes.begin(); i != sizes.end(); ++i) {
+        usage += i.value();
+    }
+    lock();
+    while(usage > maxCacheSize) {
+        // score = distance from current position + number of accesses since last use
+        int victim = -1;
+        quint64 victimScore = 0;
+        for(int i = 0; i < cachedImages->length(); i++) {
+            CacheObject *obj = cachedImages->at(i);
+            if(i == current || !obj->isLoaded())
+                continue;
+            quint64 score = qAbs(i - current) + (accessTime - obj->accessTime());
+            if(victim == -1 || score > victimScore) {
+                victim = i;
+                victimScore = score;
+            }
+        }
+        if(victim == -1)
+            break;
+        usage -= sizes.value(cachedImages->at(victim)->image().data(), 0);
+        cachedImages->at(victim)->unload();
+        unloaded.append(victim);
+        evictions.ref();
+    }
+    unlock();
+    return unloaded;
+}
+
+qint64 ImageCache::memoryUsage() {
+    QHash<Image*, qint64> sizes = imageSizes();
+    qint64 usage = 0;
+    for(QHash<Image*, qint64>::iterator i = sizes.begin(); i != sizes.end(); ++i) {
+        usage += i.value();
+    }
+    return usage;
+}
+
+qint64 ImageCache::memoryLimit() const {
+    return maxCacheSize;
+}
+
+uint ImageCache::hitCount() const {
+    return hits.load();
+}
+
+uint ImageCache::missCount() const {
+    return misses.load();
+}
+
+uint ImageCache::evictionCount() const {
+    return evictions.load();
+}
+
+void ImageCache::resetCounters() {
+    hits.store(0);
+    misses.store(0);
+    evictions.store(0);
 }
 
 
@@ -89,6 +269,30 @@ void ImageCache::setImage(Image *img, int pos) {
 // ###################### PRIVATE METHODS #######################
 // ##############################################################
 
+// called with the lock held
+void ImageCache::store(CacheObject *obj, Image *img) {
+    // last reference can be dropped in any thread;
+    // the image itself is deleted in the thread it lives in
+    obj->setImage(QSharedPointer<Image>(img, &QObject::deleteLater));
+    obj->setAccessTime(++accessTime);
+}
+
+QHash<Image*, qint64> ImageCache::imageSizes() {
+    QList<QSharedPointer<Image> > images;
+    lock();
+    for(int i = 0; i < cachedImages->length(); i++) {
+        if(cachedImages->at(i)->isLoaded()) {
+            images.append(cachedImages->at(i)->image());
+        }
+    }
+    unlock();
+    QHash<Image*, qint64> sizes;
+    for(int i = 0; i < images.count(); i++) {
+        sizes.insert(images.at(i).data(), images.at(i)->memoryUsage());
+    }
+    return sizes;
+}
+
 void ImageCache::lock() {
     mutex.lock();
 }
@@ -99,7 +303,7 @@ void ImageCache::unlock() {
 
 void ImageCache::readSettings() {
     lock();
-    //maxCacheSize = globalSettings->s.value("cacheSize").toInt();
+    maxCacheSize = (qint64) settings->cacheSize() * 1024 * 1024;
     unlock();
 }
 
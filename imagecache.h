@@ -10,53 +10,50 @@
 #include <QList>
 #include <QtConcurrent>
 #include <QMutex>
+#include <QSharedPointer>
+#include <QAtomicInt>
+#include <QHash>
 #include <ctime>
 
+// image is released on unload, but stays alive
+// until everyone holding a reference to it is done
 class CacheObject {
 public:
-    CacheObject(QString _path) : img(NULL), path(_path) {
+    CacheObject(QString _path) : position(-1), path(_path), lastAccess(0) {
     }
+    // scratch value for ImageCache::reorder()
+    int position;
 
-    ~CacheObject() {
-        if(img)
-            img->safeDeleteSelf();
+    QString filePath() {
+        return path;
     }
     FileInfo* getInfo() {
         if(img)
             return img->info();
+        return NULL;
     }
     bool isLoaded() {
-        if(img==NULL) {
-            return false;
-        } else {
-            return true;
-        }
+        return !img.isNull();
     }
     void unload() {
-        if(img) {
-            img->safeDeleteSelf();
-            img = NULL;
-        }
+        img.clear();
     }
-    void setImage(Image* _img) {
+    void setImage(QSharedPointer<Image> _img) {
         img = _img;
     }
-    Image* image() {
+    QSharedPointer<Image> image() {
         return img;
     }
-private:
-    void init() {
-
+    void setAccessTime(quint64 time) {
+        lastAccess = time;
     }
-    Image* getImg() {
-        if(!img) {
-            init();
-        }
-        if(!img) qDebug() << "returning null 1";
-        return img;
+    quint64 accessTime() {
+        return lastAccess;
     }
-    Image *img;
+private:
+    QSharedPointer<Image> img;
     QString path;
+    quint64 lastAccess;
     QMutex mutex;
 };
 
@@ -73,21 +70,67 @@ public:
     void init(QString dir, QStringList list);
     void unloadAll();
     void unloadAt(int pos);
-    Image *imageAt(int pos);
+    // single file added to / removed from the directory;
+    // everything else stays loaded
+    void insertAt(int pos, QString path);
+    void removeAt(int pos);
+    // new list for the same directory (different order, more or fewer files).
+    // Files present in both keep their images. Returns new position
+    // for every old one, -1 for files that are gone.
+    // Unlike init(), does not emit initialized()
+    QVector<int> reorder(QStringList list);
+    // holding the returned pointer keeps the image alive
+    // even if it is unloaded meanwhile
+    QSharedPointer<Image> imageAt(int pos);
+    // same by file path; for jobs whose position may be outdated
+    QSharedPointer<Image> imageFor(QString path);
     int length() const;
     QString currentDirectory();
     bool isLoaded(int pos);
+    bool isLoaded(QString path);
     int currentlyLoadedCount();
+    // takes ownership
     void setImage(Image *img, int pos);
+    // same by file path, for load jobs: positions can shift while they run.
+    // Deleted later if the file is no longer in the list
+    void setImage(Image *img, QString path);
+
+    // same as isLoaded(), but counts as a cache access:
+    // updates hit/miss statistics and LRU order
+    bool lookup(int pos);
+
+    // unloads images until decoded data fits into the memory budget
+    // least recently used images far from current position go first
+    // image at current position is never unloaded
+    // returns list of unloaded positions
+    QList<int> shrink(int current);
+
+    // decoded data size in bytes
+    qint64 memoryUsage();
+    qint64 memoryLimit() const;
+
+    uint hitCount() const;
+    uint missCount() const;
+    uint evictionCount() const;
+    void resetCounters();
 
 private:
+    // objects by file path; cachedImages is their order in the directory
+    QHash<QString, CacheObject*> objects;
     QList<CacheObject*> *cachedImages;
-    uint maxCacheSize;
+    qint64 maxCacheSize;
+    quint64 accessTime;
+    // read without the lock
+    QAtomicInt hits, misses, evictions;
     QString dir;
     QMutex mutex;
 
     void lock();
     void unlock();
+    void store(CacheObject *obj, Image *img);
+    // decoded data size of every loaded image. Measured without the lock:
+    // Image::memoryUsage() waits for the image's own lock
+    QHash<Image*, qint64> imageSizes();
     void readSettings();
 
 private slots:
@@ -3,17 +3,30 @@
 ImageFactory::ImageFactory() {
 }
 
-Image *ImageFactory::createImage(QString path) {
-    FileInfo *info = new FileInfo(path);
+ImageFactory::ImageFactory(QSize _displaySize) : displaySize(_displaySize) {
+}
+
+Image *ImageFactory::createImage(QString path, FileFormat format) {
+    Image *img = createUnloaded(path, format);
+    img->load();
+    return img;
+}
+
+Image *ImageFactory::createUnloaded(QString path, FileFormat format) {
+    if(format.isNull()) {
+        format = FormatSniffer::formatForFile(path);
+    }
+    // image takes ownership
+    FileInfo *info = new FileInfo(path, format);
     Image *img;
     if(info->getType() == ANIMATED) {
-        img = new ImageAnimated(path);
+        img = new ImageAnimated(info);
     } else if(info->getType() == VIDEO) {
-        img = new Video(path);
+        img = new Video(info);
     } else {
-        img = new ImageStatic(path);
+        ImageStatic *staticImg = new ImageStatic(info);
+        staticImg->setDisplaySize(displaySize);
+        img = staticImg;
     }
-    img->load();
-    delete info;
     return img;
 }
@@ -11,8 +11,17 @@
 class ImageFactory {
 public:
     ImageFactory();
+    // static images larger than displaySize get a reduced decode
+    ImageFactory(QSize _displaySize);
 
-    Image* createImage(QString);
+    // file is sniffed here unless its format is given
+    Image* createImage(QString, FileFormat format = FileFormat());
+
+    // same as createImage(), but does not decode anything yet
+    Image* createUnloaded(QString, FileFormat format = FileFormat());
+
+private:
+    QSize displaySize;
 };
 
 #endif // IMAGEFACTORY_H
@@ -0,0 +1,163 @@
+#include "exifreader.h"
+
+ExifReader::ExifReader(QString path) : littleEndian(false) {
+    QFile file(path);
+    if(file.open(QIODevice::ReadOnly)) {
+        readApp1(file);
+    }
+}
+
+ExifReader::ExifReader(QIODevice *device) : littleEndian(false) {
+    readApp1(*device);
+}
+
+bool ExifReader::isValid() {
+    return tiff.size() >= 8;
+}
+
+// walks the jpeg markers until APP1 "Exif" or start of scan
+bool ExifReader::readApp1(QIODevice &file) {
+    QByteArray soi = file.read(2);
+    if(soi.size() != 2 || (uchar)soi[0] != 0xFF || (uchar)soi[1] != 0xD8) {
+        return false;
+    }
+    for(;;) {
+        QByteArray header = file.read(4);
+        if(header.size() != 4 || (uchar)header[0] != 0xFF) {
+            return false;
+        }
+        uchar marker = header[1];
+        int length = ((uchar)header[2] << 8 | (uchar)header[3]) - 2;
+        if(marker == 0xDA || marker == 0xD9 || length < 0) {
+            return false;
+        }
+        if(marker == 0xE1) {
+            QByteArray data = file.read(length);
+            if(data.startsWith(QByteArray("Exif\0\0", 6))) {
+                tiff = data.mid(6);
+                if(tiff.startsWith("II")) {
+                    littleEndian = true;
+                } else if(!tiff.startsWith("MM")) {
+                    tiff.clear();
+                }
+                if(isValid() && read16(2) != 42) {
+                    tiff.clear();
+                }
+                return isValid();
+            }
+        } else if(!file.seek(file.pos() + length)) {
+            return false;
+        }
+    }
+}
+
+quint16 ExifReader::read16(int offset) {
+    if(offset < 0 || offset + 2 > tiff.size()) {
+        return 0;
+    }
+    const uchar *p = reinterpret_cast<const uchar*>(tiff.constData()) + offset;
+    return littleEndian ? (p[0] | p[1] << 8) : (p[0] << 8 | p[1]);
+}
+
+quint32 ExifReader::read32(int offset) {
+    if(offset < 0 || offset + 4 > tiff.size()) {
+        return 0;
+    }
+    const uchar *p = reinterpret_cast<const uchar*>(tiff.constData()) + offset;
+    return littleEndian ? ((quint32)p[0] | p[1] << 8 | p[2] << 16 | (quint32)p[3] << 24)
+                        : ((quint32)p[0] << 24 | p[1] << 16 | p[2] << 8 | (quint32)p[3]);
+}
+
+QImage ExifReader::thumbnail() {
+    if(!isValid()) {
+        return QImage();
+    }
+    // IFD0 is followed by the offset of IFD1, which describes the thumbnail
+    quint32 ifd0 = read32(4);
+    quint16 count = read16(ifd0);
+    quint32 ifd1 = read32(ifd0 + 2 + count * 12);
+    if(ifd0 == 0 || ifd1 == 0 || ifd1 >= (quint32)tiff.size()) {
+        return QImage();
+    }
+    quint32 offset = 0, length = 0;
+    count = read16(ifd1);
+    for(int i = 0; i < count; i++) {
+        int entry = ifd1 + 2 + i * 12;
+        quint16 tag = read16(entry);
+        if(tag == 0x0201) {
+            offset = read32(entry + 8);
+        } else if(tag == 0x0202) {
+            length = read32(entry + 8);
+        }
+    }
+    if(offset == 0 || length == 0 || offset > (quint32)tiff.size() ||
+       length > (quint32)tiff.size() - offset)
+    {
+        return QImage();
+    }
+    return QImage::fromData(reinterpret_cast<const uchar*>(tiff.constData()) + offset,
+                            length, "JPEG");
+}
+
+int ExifReader::findTag(quint32 ifd, quint16 tag) {
+    if(ifd == 0 || ifd >= (quint32)tiff.size()) {
+        return 0;
+    }
+    quint16 count = read16(ifd);
+    for(int i = 0; i < count; i++) {
+        int entry = ifd + 2 + i * 12;
+        if(entry + 12 > tiff.size()) {
+            return 0;
+        }
+        if(read16(entry) == tag) {
+            return entry;
+        }
+    }
+    return 0;
+}
+
+// values up to 4 bytes are stored in the entry itself
+QByteArray ExifReader::readString(int entry) {
+    quint32 count = read32(entry + 4);
+    quint32 offset = (count <= 4) ? entry + 8 : read32(entry + 8);
+    if(read16(entry + 2) != 2 || offset > (quint32)tiff.size() ||
+       count > (quint32)tiff.size() - offset)
+    {
+        return QByteArray();
+    }
+    QByteArray value = tiff.mid(offset, count);
+    int end = value.indexOf('\0');
+    return (end == -1) ? value : value.left(end);
+}
+
+int ExifReader::orientation() {
+    if(!isValid()) {
+        return 1;
+    }
+    int entry = findTag(read32(4), 0x0112);
+    int value = entry ? read16(entry + 8) : 1;
+    return (value >= 1 && value <= 8) ? value : 1;
+}
+
+QDateTime ExifReader::dateTaken() {
+    if(!isValid()) {
+        return QDateTime();
+    }
+    quint32 ifd0 = read32(4);
+    QByteArray date;
+    // DateTimeOriginal lives in the Exif sub-IFD
+    int exifPointer = findTag(ifd0, 0x8769);
+    if(exifPointer) {
+        int entry = findTag(read32(exifPointer + 8), 0x9003);
+        if(entry) {
+            date = readString(entry);
+        }
+    }
+    if(date.isEmpty()) {
+        int entry = findTag(ifd0, 0x0132);
+        if(entry) {
+            date = readString(entry);
+        }
+    }
+    return QDateTime::fromString(QString::fromLatin1(date), "yyyy:MM:dd HH:mm:ss");
+}
@@ -0,0 +1,37 @@
+#ifndef EXIFREADER_H
+#define EXIFREADER_H
+
+#include <QFile>
+#include <QIODevice>
+#include <QImage>
+#include <QByteArray>
+#include <QDateTime>
+
+// minimal EXIF reader for jpeg files. Reads only the APP1 segment
+class ExifReader {
+public:
+    ExifReader(QString path);
+    // reads from the current position of an open device
+    ExifReader(QIODevice *device);
+    bool isValid();
+    // embedded jpeg thumbnail from IFD1, null if there is none
+    QImage thumbnail();
+    // 1 to 8 as in the Orientation tag, 1 if there is none
+    int orientation();
+    // DateTimeOriginal, or DateTime if there is none. Invalid if neither
+    QDateTime dateTaken();
+
+private:
+    QByteArray tiff;
+    bool littleEndian;
+
+    quint16 read16(int offset);
+    quint32 read32(int offset);
+    bool readApp1(QIODevice &file);
+    // offset of the tag's entry in the IFD, 0 if it is not there
+    int findTag(quint32 ifd, quint16 tag);
+    // ASCII value of an entry
+    QByteArray readString(int entry);
+};
+
+#endif // EXIFREADER_H
@@ -4,12 +4,24 @@
 #include <QImage>
 #include <QPainter>
 #include <QDebug>
+#include <QThread>
+#include <QtConcurrent>
+#include "resampler.h"
 
 class ImageLib {
 public:
     ImageLib();
     void bilinearScale(QPixmap *dest, QPixmap *source, QSize destSize, bool smooth);
     void bicubicScale(QPixmap *outPixmap, const QImage *in, int destWidth, int destHeight);
+    // output is split into bands of rows which are scaled in parallel
+    void scale(QPixmap *outPixmap, const QImage *in, QSize destSize, Resampler::Filter filter);
+    // same, usable outside of gui thread. Gives up and returns a null image
+    // once *generation changes from expected. Null for an empty destSize
+    QImage scaled(const QImage *in, QSize destSize, Resampler::Filter filter,
+                  const QAtomicInt *generation = NULL, int expected = 0);
+
+private:
+    const int MIN_BAND_HEIGHT = 32;
 };
 
 #endif // IMAGELIB_H
@@ -0,0 +1,80 @@
+#include "imagepyramid.h"
+
+// level 0 shares the image's data in its original format;
+// an extra full size copy would not be counted by the cache
+ImagePyramid::ImagePyramid(const QImage &image) {
+    levels.append(image);
+}
+
+// Levels are built outside of the lock, so memoryUsage() does not wait
+// for a large image to be halved. If two threads build the same level
+// at once, the second one is dropped
+QImage ImagePyramid::nearest(QSize target) {
+    int i = 0;
+    while(true) {
+        mutex.lock();
+        QImage level = levels.at(i);
+        bool built = (i + 1 < levels.count());
+        mutex.unlock();
+        QSize next((level.width() + 1) / 2, (level.height() + 1) / 2);
+        if(next.width() < target.width() || next.height() < target.height() ||
+           next.width() < MIN_LEVEL_SIZE || next.height() < MIN_LEVEL_SIZE)
+        {
+            return level;
+        }
+        if(!built) {
+            // halved() averages 32 bit pixels.
+            // Converted copy of the full image is only kept while halving
+            QImage half;
+            if(level.format() != QImage::Format_RGB32 &&
+               level.format() != QImage::Format_ARGB32_Premultiplied)
+            {
+                half = halved(level.convertToFormat(QImage::Format_ARGB32_Premultiplied));
+            } else {
+                half = halved(level);
+            }
+            mutex.lock();
+            if(i + 1 == levels.count()) {
+                levels.append(half);
+            }
+            mutex.unlock();
+        }
+        i++;
+    }
+}
+
+qint64 ImagePyramid::memoryUsage() {
+    QMutexLocker locker(&mutex);
+    qint64 bytes = 0;
+    for(int i = 1; i < levels.count(); i++) {
+        bytes += levels.at(i).byteCount();
+    }
+    return bytes;
+}
+
+// averages 2x2 blocks, two channels at a time.
+// Odd last row / column is averaged with itself
+QImage ImagePyramid::halved(const QImage &source) const {
+    const quint32 mask = 0x00FF00FF;
+    QImage result((source.width() + 1) / 2, (source.height() + 1) / 2, source.format());
+    for(int y = 0; y < result.height(); y++) {
+        const quint32 *top = reinterpret_cast<const quint32*>(source.constScanLine(y * 2));
+        const quint32 *bottom = reinterpret_cast<const quint32*>(
+                    source.constScanLine(qMin(y * 2 + 1, source.height() - 1)));
+        quint32 *out = reinterpret_cast<quint32*>(result.scanLine(y));
+        for(int x = 0; x < result.width(); x++) {
+            int x0 = x * 2;
+            int x1 = qMin(x0 + 1, source.width() - 1);
+            quint32 p[4] = { top[x0], top[x1], bottom[x0], bottom[x1] };
+            quint32 low = 0, high = 0;
+            for(int i = 0; i < 4; i++) {
+                low += p[i] & mask;
+                high += (p[i] >> 8) & mask;
+            }
+            low = ((low + 0x00020002) >> 2) & mask;
+            high = ((high + 0x00020002) >> 2) & mask;
+            out[x] = low | high << 8;
+        }
+    }
+    return result;
+}
@@ -0,0 +1,29 @@
+#ifndef IMAGEPYRAMID_H
+#define IMAGEPYRAMID_H
+
+#include <QImage>
+#include <QVector>
+#include <QMutex>
+
+// Chain of half size copies of an image (1/2, 1/4, ...).
+// Levels are built on first use from the previous one with a 2x2 box
+// filter; zoomed views are then scaled from the closest larger level
+// instead of the full image. Safe to use from several threads.
+class ImagePyramid {
+public:
+    ImagePyramid(const QImage &image);
+
+    // smallest level that is at least as large as target
+    QImage nearest(QSize target);
+    // bytes used by the levels built so far, not counting the full image
+    qint64 memoryUsage();
+
+private:
+    QVector<QImage> levels;
+    QMutex mutex;
+
+    const int MIN_LEVEL_SIZE = 32;
+    QImage halved(const QImage &source) const;
+};
+
+#endif // IMAGEPYRAMID_H
@@ -0,0 +1,81 @@
+#ifndef POOLMAP_H
+#define POOLMAP_H
+
+#include <QThread>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QFuture>
+#include <QFutureInterface>
+#include <QSharedPointer>
+#include <QAtomicInt>
+#include <QVector>
+#include <QList>
+
+// QtConcurrent::mapped() for a given pool; the Qt5 one always uses
+// the global pool, where it delays everything else that runs there.
+// Items are processed in chunks at low thread priority. The returned
+// future reports results per chunk (resultsReadyAt) and can be watched,
+// cancelled and waited for like a mapped one.
+template <typename Functor, typename T>
+class PoolMapChunk : public QRunnable {
+public:
+    typedef typename Functor::result_type R;
+
+    PoolMapChunk(QFutureInterface<R> _future, const QList<T> &_items, int _begin,
+                 Functor _functor, QSharedPointer<QAtomicInt> _remaining)
+        : future(_future),
+          items(_items),
+          begin(_begin),
+          functor(_functor),
+          remaining(_remaining)
+    {
+    }
+
+    void run() {
+        QThread::currentThread()->setPriority(QThread::LowPriority);
+        QVector<R> results;
+        results.reserve(items.count());
+        for(int i = 0; i < items.count() && !future.isCanceled(); i++) {
+            results.append(functor(items.at(i)));
+        }
+        if(!future.isCanceled()) {
+            future.reportResults(results, begin, results.count());
+        }
+        // the last chunk to end finishes the future
+        if(!remaining->deref()) {
+            future.reportFinished();
+        }
+    }
+
+private:
+    QFutureInterface<R> future;
+    QList<T> items;
+    int begin;
+    Functor functor;
+    QSharedPointer<QAtomicInt> remaining;
+};
+
+template <typename Functor, typename T>
+QFuture<typename Functor::result_type> mappedOnPool(QThreadPool *pool,
+                                                    const QList<T> &items,
+                                                    Functor functor,
+                                                    int chunkSize)
+{
+    typedef typename Functor::result_type R;
+    QFutureInterface<R> future;
+    future.reportStarted();
+    QFuture<R> result = future.future();
+    if(items.isEmpty()) {
+        future.reportFinished();
+        return result;
+    }
+    int chunks = (items.count() + chunkSize - 1) / chunkSize;
+    QSharedPointer<QAtomicInt> remaining(new QAtomicInt(chunks));
+    for(int begin = 0; begin < items.count(); begin += chunkSize) {
+        pool->start(new PoolMapChunk<Functor, T>(future, items.mid(begin, chunkSize),
+                                                 begin, functor, remaining));
+    }
+    return result;
+}
+
+#endif // POOLMAP_H
@@ -0,0 +1,438 @@
+#include "resampler.h"
+#include <cmath>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+    #define RESAMPLER_X86
+    #include <emmintrin.h>
+    #include <immintrin.h>
+    #ifdef _MSC_VER
+        #include <intrin.h>
+    #endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    #define RESAMPLER_NEON
+    #include <arm_neon.h>
+#endif
+
+#if defined(RESAMPLER_X86) && (defined(__GNUC__) || defined(__clang__))
+    #define TARGET_SSE2 __attribute__((target("sse2")))
+    #define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+    #define TARGET_SSE2
+    #define TARGET_AVX2
+#endif
+
+typedef void (*HorizontalKernel)(const quint32 *src, float *dst, int width,
+                                 const Resampler::Weights &weights);
+// combines taps float rows into one row of 32 bit pixels
+typedef void (*VerticalKernel)(const float * const *rows, const float *weights, int taps,
+                               quint32 *dst, int width);
+
+static inline float bilinearFilter(float x) {
+    x = std::fabs(x);
+    return x < 1.0f ? 1.0f - x : 0.0f;
+}
+
+// Catmull-Rom, same curve as the old per pixel interpolation
+static inline float bicubicFilter(float x) {
+    const float a = -0.5f;
+    x = std::fabs(x);
+    if(x < 1.0f) {
+        return ((a + 2.0f) * x - (a + 3.0f)) * x * x + 1.0f;
+    }
+    if(x < 2.0f) {
+        return (((x - 5.0f) * x + 8.0f) * x - 4.0f) * a;
+    }
+    return 0.0f;
+}
+
+// ##############################################################
+// ########################### SCALAR ###########################
+// ##############################################################
+
+static void horizontalScalar(const quint32 *src, float *dst, int width,
+                             const Resampler::Weights &weights)
+{
+    for(int x = 0; x < width; x++) {
+        const quint32 *p = src + weights.start[x];
+        const float *k = weights.values.constData() + x * weights.maxTaps;
+        float b = 0, g = 0, r = 0, a = 0;
+        for(int i = 0; i < weights.count[x]; i++) {
+            b += k[i] * (p[i] & 0xFF);
+            g += k[i] * ((p[i] >> 8) & 0xFF);
+            r += k[i] * ((p[i] >> 16) & 0xFF);
+            a += k[i] * (p[i] >> 24);
+        }
+        dst[x * 4]     = b;
+        dst[x * 4 + 1] = g;
+        dst[x * 4 + 2] = r;
+        dst[x * 4 + 3] = a;
+    }
+}
+
+static inline quint32 clampChannel(float v, float max) {
+    v = v < 0.0f ? 0.0f : (v > max ? max : v);
+    return (quint32)(v + 0.5f);
+}
+
+static void verticalScalar(const float * const *rows, const float *weights, int taps,
+                           quint32 *dst, int width)
+{
+    for(int x = 0; x < width * 4; x += 4) {
+        float acc[4] = { 0, 0, 0, 0 };
+        for(int i = 0; i < taps; i++) {
+            for(int c = 0; c < 4; c++) {
+                acc[c] += weights[i] * rows[i][x + c];
+            }
+        }
+        // cubic overshoot must not break premultiplication
+        quint32 a = clampChannel(acc[3], 255.0f);
+        dst[x / 4] = clampChannel(acc[0], a) |
+                     clampChannel(acc[1], a) << 8 |
+                     clampChannel(acc[2], a) << 16 |
+                     a << 24;
+    }
+}
+
+// ##############################################################
+// ############################ X86 #############################
+// ##############################################################
+
+#ifdef RESAMPLER_X86
+TARGET_SSE2
+static void horizontalSSE2(const quint32 *src, float *dst, int width,
+                           const Resampler::Weights &weights)
+{
+    const __m128i zero = _mm_setzero_si128();
+    for(int x = 0; x < width; x++) {
+        const quint32 *p = src + weights.start[x];
+        const float *k = weights.values.constData() + x * weights.maxTaps;
+        __m128 acc = _mm_setzero_ps();
+        for(int i = 0; i < weights.count[x]; i++) {
+            __m128i pixel = _mm_cvtsi32_si128((int)p[i]);
+            pixel = _mm_unpacklo_epi16(_mm_unpacklo_epi8(pixel, zero), zero);
+            acc = _mm_add_ps(acc, _mm_mul_ps(_mm_cvtepi32_ps(pixel), _mm_set1_ps(k[i])));
+        }
+        _mm_storeu_ps(dst + x * 4, acc);
+    }
+}
+
+// rounds half up like the scalar version, not to nearest even
+TARGET_SSE2
+static inline quint32 packPixelSSE2(__m128 acc) {
+    // color <= alpha, then saturate to 0..255
+    acc = _mm_min_ps(acc, _mm_shuffle_ps(acc, acc, _MM_SHUFFLE(3, 3, 3, 3)));
+    __m128i v = _mm_cvttps_epi32(_mm_add_ps(acc, _mm_set1_ps(0.5f)));
+    v = _mm_packs_epi32(v, v);
+    v = _mm_packus_epi16(v, v);
+    return (quint32)_mm_cvtsi128_si32(v);
+}
+
+TARGET_SSE2
+static void verticalSSE2(const float * const *rows, const float *weights, int taps,
+                         quint32 *dst, int width)
+{
+    for(int x = 0; x < width; x++) {
+        __m128 acc = _mm_setzero_ps();
+        for(int i = 0; i < taps; i++) {
+            acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(rows[i] + x * 4),
+                                             _mm_set1_ps(weights[i])));
+        }
+        dst[x] = packPixelSSE2(acc);
+    }
+}
+
+// two pixels per iteration
+TARGET_AVX2
+static void verticalAVX2(const float * const *rows, const float *weights, int taps,
+                         quint32 *dst, int width)
+{
+    int x = 0;
+    for(; x + 2 <= width; x += 2) {
+        __m256 acc = _mm256_setzero_ps();
+        for(int i = 0; i < taps; i++) {
+            acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_loadu_ps(rows[i] + x * 4),
+                                                   _mm256_set1_ps(weights[i])));
+        }
+        acc = _mm256_min_ps(acc, _mm256_permute_ps(acc, _MM_SHUFFLE(3, 3, 3, 3)));
+        __m256i v = _mm256_cvttps_epi32(_mm256_add_ps(acc, _mm256_set1_ps(0.5f)));
+        v = _mm256_packs_epi32(v, v);
+        v = _mm256_packus_epi16(v, v);
+        dst[x]     = (quint32)_mm_cvtsi128_si32(_mm256_castsi256_si128(v));
+        dst[x + 1] = (quint32)_mm_cvtsi128_si32(_mm256_extracti128_si256(v, 1));
+    }
+    for(; x < width; x++) {
+        __m128 acc = _mm_setzero_ps();
+        for(int i = 0; i < taps; i++) {
+            acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(rows[i] + x * 4),
+                                             _mm_set1_ps(weights[i])));
+        }
+        dst[x] = packPixelSSE2(acc);
+    }
+}
+
+static bool cpuHasSSE2() {
+#if defined(__x86_64__) || defined(_M_X64)
+    return true;
+#elif defined(__GNUC__) || defined(__clang__)
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse2");
+#else
+    int info[4];
+    __cpuid(info, 1);
+    return (info[3] & (1 << 26)) != 0;
+#endif
+}
+
+static bool cpuHasAVX2() {
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#else
+    int info[4];
+    __cpuid(info, 0);
+    if(info[0] < 7) {
+        return false;
+    }
+    __cpuid(info, 1);
+    // avx and os support for ymm registers
+    if((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0 ||
+       (_xgetbv(0) & 6) != 6)
+    {
+        return false;
+    }
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#endif
+}
+#endif
+
+// ##############################################################
+// ############################ NEON ############################
+// ##############################################################
+
+#ifdef RESAMPLER_NEON
+static void horizontalNEON(const quint32 *src, float *dst, int width,
+                           const Resampler::Weights &weights)
+{
+    for(int x = 0; x < width; x++) {
+        const quint32 *p = src + weights.start[x];
+        const float *k = weights.values.constData() + x * weights.maxTaps;
+        float32x4_t acc = vdupq_n_f32(0.0f);
+        for(int i = 0; i < weights.count[x]; i++) {
+            uint16x8_t pixel = vmovl_u8(vreinterpret_u8_u32(vdup_n_u32(p[i])));
+            float32x4_t v = vcvtq_f32_u32(vmovl_u16(vget_low_u16(pixel)));
+            acc = vmlaq_n_f32(acc, v, k[i]);
+        }
+        vst1q_f32(dst + x * 4, acc);
+    }
+}
+
+static void verticalNEON(const float * const *rows, const float *weights, int taps,
+                         quint32 *dst, int width)
+{
+    const float32x4_t zero = vdupq_n_f32(0.0f);
+    const float32x4_t half = vdupq_n_f32(0.5f);
+    for(int x = 0; x < width; x++) {
+        float32x4_t acc = zero;
+        for(int i = 0; i < taps; i++) {
+            acc = vmlaq_n_f32(acc, vld1q_f32(rows[i] + x * 4), weights[i]);
+        }
+        acc = vminq_f32(acc, vdupq_n_f32(vgetq_lane_f32(acc, 3)));
+        acc = vaddq_f32(vmaxq_f32(acc, zero), half);
+        uint16x4_t v16 = vqmovn_u32(vcvtq_u32_f32(acc));
+        uint8x8_t v8 = vqmovn_u16(vcombine_u16(v16, v16));
+        dst[x] = vget_lane_u32(vreinterpret_u32_u8(v8), 0);
+    }
+}
+#endif
+
+// ##############################################################
+// ########################## DISPATCH ##########################
+// ##############################################################
+
+struct Kernels {
+    HorizontalKernel horizontal;
+    VerticalKernel vertical;
+    const char *name;
+};
+
+// every kernel set this cpu can run, fastest last
+static QVector<Kernels> supportedKernels() {
+    QVector<Kernels> supported;
+    Kernels scalar = { horizontalScalar, verticalScalar, "scalar" };
+    supported.append(scalar);
+#ifdef RESAMPLER_X86
+    if(cpuHasSSE2()) {
+        Kernels sse2 = { horizontalSSE2, verticalSSE2, "sse2" };
+        supported.append(sse2);
+        if(cpuHasAVX2()) {
+            Kernels avx2 = { horizontalSSE2, verticalAVX2, "avx2" };
+            supported.append(avx2);
+        }
+    }
+#elif defined(RESAMPLER_NEON)
+    Kernels neon = { horizontalNEON, verticalNEON, "neon" };
+    supported.append(neon);
+#endif
+    return supported;
+}
+
+static Kernels& kernels() {
+    static Kernels active = supportedKernels().last();
+    return active;
+}
+
+const char* Resampler::kernelName() {
+    return kernels().name;
+}
+
+QStringList Resampler::availableKernels() {
+    QStringList names;
+    QVector<Kernels> supported = supportedKernels();
+    for(int i = 0; i < supported.count(); i++) {
+        names.append(QString::fromLatin1(supported.at(i).name));
+    }
+    return names;
+}
+
+bool Resampler::setKernel(QString name) {
+    QVector<Kernels> supported = supportedKernels();
+    for(int i = 0; i < supported.count(); i++) {
+        if(name == QLatin1String(supported.at(i).name)) {
+            kernels() = supported.at(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+// ##############################################################
+// ########################## RESAMPLER #########################
+// ##############################################################
+
+Resampler::Resampler(int _srcWidth, int _srcHeight, int _dstWidth, int _dstHeight, Filter filter)
+    : srcWidth(_srcWidth),
+      srcHeight(_srcHeight),
+      dstWidth(_dstWidth),
+      dstHeight(_dstHeight)
+{
+    computeWeights(horizontal, srcWidth, dstWidth, filter);
+    computeWeights(vertical, srcHeight, dstHeight, filter);
+}
+
+// when downscaling the filter is stretched over the source pixels
+// that map onto one output pixel, which avoids aliasing
+void Resampler::computeWeights(Weights &weights, int srcSize, int dstSize, Filter filter) {
+    // empty target: no output rows or columns to filter
+    if(dstSize <= 0 || srcSize <= 0) {
+        weights.maxTaps = 1;
+        weights.start.clear();
+        weights.count.clear();
+        weights.values.clear();
+        return;
+    }
+    const float support = (filter == FILTER_BILINEAR) ? 1.0f : 2.0f;
+    float scale = (float)srcSize / dstSize;
+    float filterScale = qMax(scale, 1.0f);
+    float radius = support * filterScale;
+
+    weights.maxTaps = (int)std::ceil(radius) * 2 + 1;
+    weights.start.resize(dstSize);
+    weights.count.resize(dstSize);
+    weights.values.fill(0.0f, dstSize * weights.maxTaps);
+
+    for(int i = 0; i < dstSize; i++) {
+        float center = (i + 0.5f) * scale;
+        int first = qMax((int)std::floor(center - radius + 0.5f), 0);
+        int last = qMin((int)std::floor(center + radius + 0.5f), srcSize);
+        if(last - first > weights.maxTaps) {
+            last = first + weights.maxTaps;
+        }
+        if(last <= first) {
+            first = qBound(0, (int)center, srcSize - 1);
+            last = first + 1;
+        }
+        float *k = weights.values.data() + i * weights.maxTaps;
+        float sum = 0.0f;
+        for(int j = first; j < last; j++) {
+            float x = (j + 0.5f - center) / filterScale;
+            k[j - first] = (filter == FILTER_BILINEAR) ? bilinearFilter(x) : bicubicFilter(x);
+            sum += k[j - first];
+        }
+        if(sum != 0.0f) {
+            for(int j = 0; j < last - first; j++) {
+                k[j] /= sum;
+            }
+        } else {
+            k[0] = 1.0f;
+            last = first + 1;
+        }
+        weights.start[i] = first;
+        weights.count[i] = last - first;
+    }
+}
+
+bool Resampler::resample(const uchar *src, int srcStride,
+                         uchar *dst, int dstStride,
+                         int first, int last,
+                         const QAtomicInt *generation, int expected) const
+{
+    return run(src, srcStride, dst, dstStride, 0, horizontal, first, last, generation, expected);
+}
+
+bool Resampler::resampleArea(const uchar *src, int srcStride,
+                             uchar *dst, int dstStride,
+                             int left, int top, int width, int height) const
+{
+    left = qMax(left, 0);
+    width = qMin(width, dstWidth - left);
+    if(width <= 0) {
+        return true;
+    }
+    // horizontal weights of the requested columns only
+    Weights columns;
+    columns.maxTaps = horizontal.maxTaps;
+    columns.start = horizontal.start.mid(left, width);
+    columns.count = horizontal.count.mid(left, width);
+    columns.values = horizontal.values.mid(left * horizontal.maxTaps, width * horizontal.maxTaps);
+    return run(src, srcStride, dst, dstStride, top,
+               columns, top, top + height, NULL, 0);
+}
+
+bool Resampler::run(const uchar *src, int srcStride,
+                    uchar *dst, int dstStride, int dstTop,
+                    const Weights &columns, int first, int last,
+                    const QAtomicInt *generation, int expected) const
+{
+    const Kernels &k = kernels();
+    const int width = columns.start.size();
+    // horizontally filtered source rows, slot = source row % ringSize.
+    // Rows needed by one output row never share a slot
+    const int ringSize = vertical.maxTaps;
+    const int rowLength = width * 4;
+    QVector<float> ring(ringSize * rowLength);
+    QVector<int> ringRow(ringSize, -1);
+    QVector<const float*> taps(vertical.maxTaps);
+
+    for(int y = qMax(first, 0); y < qMin(last, dstHeight); y++) {
+        if(generation && generation->load() != expected) {
+            return false;
+        }
+        int start = vertical.start[y];
+        int count = vertical.count[y];
+        for(int i = 0; i < count; i++) {
+            int row = start + i;
+            int slot = row % ringSize;
+            float *buffer = ring.data() + slot * rowLength;
+            if(ringRow[slot] != row) {
+                k.horizontal(reinterpret_cast<const quint32*>(src + (qint64)row * srcStride),
+                             buffer, width, columns);
+                ringRow[slot] = row;
+            }
+            taps[i] = buffer;
+        }
+        k.vertical(taps.constData(), vertical.values.constData() + y * vertical.maxTaps, count,
+                   reinterpret_cast<quint32*>(dst + (qint64)(y - dstTop) * dstStride), width);
+    }
+    return true;
+}
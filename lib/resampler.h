@@ -0,0 +1,63 @@
+#ifndef RESAMPLER_H
+#define RESAMPLER_H
+
+#include <QtGlobal>
+#include <QVector>
+#include <QAtomicInt>
+#include <QStringList>
+
+// Separable two pass scaler for 32 bit pixels
+// (QImage::Format_RGB32 or Format_ARGB32_Premultiplied).
+// Filter weights are computed once per axis. Source rows are filtered
+// horizontally into a small ring buffer of float rows, which the vertical
+// pass combines into output rows.
+// Inner loops have SSE2, AVX2 and NEON versions, picked at runtime.
+class Resampler {
+public:
+    enum Filter { FILTER_BILINEAR, FILTER_BICUBIC };
+
+    Resampler(int _srcWidth, int _srcHeight, int _dstWidth, int _dstHeight, Filter filter);
+
+    // writes output rows [first, last). Does not modify the object,
+    // so disjoint row ranges can be processed from different threads.
+    // Stops early once *generation no longer equals expected.
+    // Returns false if it did
+    bool resample(const uchar *src, int srcStride,
+                  uchar *dst, int dstStride,
+                  int first, int last,
+                  const QAtomicInt *generation = NULL, int expected = 0) const;
+
+    // writes the width x height block of the output at (left, top).
+    // dst points to the first pixel of the block, not of the whole output
+    bool resampleArea(const uchar *src, int srcStride,
+                      uchar *dst, int dstStride,
+                      int left, int top, int width, int height) const;
+
+    // which instruction set the kernels use
+    static const char* kernelName();
+    // kernel names this cpu supports, "scalar" first
+    static QStringList availableKernels();
+    // switches all resamplers to the given kernels, used by the tests.
+    // Not safe while other threads are resampling
+    static bool setKernel(QString name);
+
+    struct Weights {
+        QVector<int> start, count;
+        // maxTaps values per output pixel
+        QVector<float> values;
+        int maxTaps;
+    };
+
+private:
+    int srcWidth, srcHeight, dstWidth, dstHeight;
+    Weights horizontal, vertical;
+
+    void computeWeights(Weights &weights, int srcSize, int dstSize, Filter filter);
+    // output row y is written to dst + (y - dstTop) * dstStride
+    bool run(const uchar *src, int srcStride,
+             uchar *dst, int dstStride, int dstTop,
+             const Weights &columns, int first, int last,
+             const QAtomicInt *generation, int expected) const;
+};
+
+#endif // RESAMPLER_H
@@ -1,39 +1,62 @@
 #include "loadhelper.h"
 
-LoadHelper::LoadHelper(ImageCache *_cache, QThread *_mainThread) :
+LoadHelper::LoadHelper(LoadQueue *_queue, ImageCache *_cache, QThread *_mainThread, QSize _displaySize) :
+    queue(_queue),
     cache(_cache),
-    loadTarget(-1),
-    mainThread(_mainThread) {
+    mainThread(_mainThread),
+    displaySize(_displaySize) {
 
 }
 
-void LoadHelper::setTarget(int pos, QString _path) {
-    mutex.lock();
-    loadTarget = pos;
-    path = _path;
-    mutex.unlock();
-}
-
-int LoadHelper::target() {
-    return loadTarget;
+void LoadHelper::doLoad() {
+    QSharedPointer<LoadJob> job;
+    while(!(job = queue->take()).isNull()) {
+        load(job);
+    }
 }
 
-void LoadHelper::doLoad() {
-    mutex.lock();
-    int targetLocal = loadTarget;
-    QString pathLocal = path;
-    mutex.unlock();
-    if(cache->isLoaded(targetLocal)) {
-        emit finished(targetLocal);
+// job is checked for cancellation between stages;
+// a superseded job stops there and its result is thrown away
+void LoadHelper::load(QSharedPointer<LoadJob> job) {
+    if(job->isCancelled()) {
+        queue->discard(job);
+        return;
+    }
+    if(cache->isLoaded(job->path)) {
+        queue->discard(job);
+        emit finished(job->path);
         return;
     }
-    //qDebug() << "LOADHELPER: loading! "<< targetLocal;
-    ImageFactory *factory = new ImageFactory();
-    Image *img = factory->createImage(pathLocal);
+    // file type detection
+    ImageFactory *factory = new ImageFactory(displaySize);
+    Image *img = factory->createUnloaded(job->path, job->format);
     delete factory;
-
+    if(job->isCancelled()) {
+        delete img;
+        queue->discard(job);
+        return;
+    }
+    if(job->priority == PRIORITY_CURRENT) {
+        ImageStatic *staticImg = dynamic_cast<ImageStatic*>(img);
+        if(staticImg) {
+            QSize realSize;
+            QImage preview = staticImg->preview(realSize);
+            if(!preview.isNull() && !job->isCancelled()) {
+                emit previewReady(job->path, preview, realSize);
+            }
+        }
+    }
+    // decoding
+    img->load();
+    if(job->isCancelled()) {
+        delete img;
+        queue->discard(job);
+        return;
+    }
     img->moveToThread(mainThread);
-    cache->setImage(img, targetLocal);
-
-    emit finished(targetLocal);
+    if(queue->commit(job, img)) {
+        emit finished(job->path);
+    } else {
+        img->deleteLater();
+    }
 }
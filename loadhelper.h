@@ -5,27 +5,31 @@
 #include <QMutex>
 #include "imagecache.h"
 #include "imagefactory.h"
+#include "loadqueue.h"
 
 class LoadHelper : public QObject
 {
     Q_OBJECT
 public:
-    explicit LoadHelper(ImageCache *_cache, QThread *mainThread);
-    void setTarget(int pos, QString);
-    int target();
+    explicit LoadHelper(LoadQueue *_queue, ImageCache *_cache, QThread *mainThread, QSize _displaySize);
 
 public slots:
+    // runs jobs from the queue until it is empty
     void doLoad();
 
 private:
+    LoadQueue *queue;
     ImageCache *cache;
-    int loadTarget;
-    QString path;
-    QMutex mutex;
     QThread *mainThread;
+    QSize displaySize;
+
+    void load(QSharedPointer<LoadJob> job);
 
 signals:
-    void finished(int);
+    // by file path: job positions are changed by the gui thread meanwhile
+    void finished(QString);
+    // low quality version of a current image, emitted before decoding it
+    void previewReady(QString, QImage, QSize);
 
 };
 
@@ -0,0 +1,200 @@
+#include "loadqueue.h"
+
+LoadJob::LoadJob(int _pos, QString _path, LoadPriority _priority, FileFormat _format) :
+    pos(_pos),
+    path(_path),
+    format(_format),
+    priority(_priority),
+    cancelled(0)
+{
+}
+
+bool LoadJob::isCancelled() const {
+    return cancelled.load() != 0;
+}
+
+LoadQueue::LoadQueue(ImageCache *_cache) :
+    cache(_cache),
+    workerCount(2)
+{
+}
+
+// ##############################################################
+// ####################### PUBLIC METHODS #######################
+// ##############################################################
+
+void LoadQueue::setWorkerCount(int count) {
+    QMutexLocker locker(&mutex);
+    workerCount = count;
+}
+
+void LoadQueue::push(int pos, QString path, LoadPriority priority, FileFormat format) {
+    QMutexLocker locker(&mutex);
+    for(int i = 0; i < running.count(); i++) {
+        QSharedPointer<LoadJob> job = running.at(i);
+        if(job->pos == pos && !job->isCancelled()) {
+            if(priority < job->priority)
+                job->priority = priority;
+            return;
+        }
+    }
+    for(int i = 0; i < queued.count(); i++) {
+        if(queued.at(i)->pos == pos) {
+            if(priority >= queued.at(i)->priority)
+                return;
+            // re-insert with higher priority
+            queued.removeAt(i);
+            break;
+        }
+    }
+    // keep queue sorted by priority, FIFO within the same priority
+    int i = 0;
+    while(i < queued.count() && queued.at(i)->priority <= priority)
+        i++;
+    queued.insert(i, QSharedPointer<LoadJob>(new LoadJob(pos, path, priority, format)));
+}
+
+QSharedPointer<LoadJob> LoadQueue::take() {
+    QMutexLocker locker(&mutex);
+    for(int i = 0; i < queued.count(); i++) {
+        QSharedPointer<LoadJob> job = queued.at(i);
+        if(!canStart(job)) {
+            continue;
+        }
+        queued.removeAt(i);
+        running.append(job);
+        return job;
+    }
+    return QSharedPointer<LoadJob>();
+}
+
+void LoadQueue::cancelExcept(const QList<int> &positions) {
+    QMutexLocker locker(&mutex);
+    for(int i = queued.count() - 1; i >= 0; i--) {
+        if(!positions.contains(queued.at(i)->pos)) {
+            queued.at(i)->cancelled.store(1);
+            queued.removeAt(i);
+        }
+    }
+    for(int i = 0; i < running.count(); i++) {
+        if(!positions.contains(running.at(i)->pos)) {
+            running.at(i)->cancelled.store(1);
+        }
+    }
+    jobsRetired.wakeAll();
+}
+
+void LoadQueue::cancelAll() {
+    cancelExcept(QList<int>());
+}
+
+void LoadQueue::shiftPositions(int pos, int delta) {
+    QMutexLocker locker(&mutex);
+    for(int i = queued.count() - 1; i >= 0; i--) {
+        QSharedPointer<LoadJob> job = queued.at(i);
+        if(delta < 0 && job->pos == pos) {
+            job->cancelled.store(1);
+            queued.removeAt(i);
+        } else if(job->pos >= pos) {
+            job->pos += delta;
+        }
+    }
+    for(int i = 0; i < running.count(); i++) {
+        QSharedPointer<LoadJob> job = running.at(i);
+        if(delta < 0 && job->pos == pos) {
+            job->cancelled.store(1);
+        } else if(job->pos >= pos) {
+            job->pos += delta;
+        }
+    }
+    jobsRetired.wakeAll();
+}
+
+void LoadQueue::remap(const QVector<int> &moved) {
+    QMutexLocker locker(&mutex);
+    for(int i = queued.count() - 1; i >= 0; i--) {
+        QSharedPointer<LoadJob> job = queued.at(i);
+        job->pos = moved.value(job->pos, -1);
+        if(job->pos == -1) {
+            job->cancelled.store(1);
+            queued.removeAt(i);
+        }
+    }
+    for(int i = 0; i < running.count(); i++) {
+        QSharedPointer<LoadJob> job = running.at(i);
+        job->pos = moved.value(job->pos, -1);
+        if(job->pos == -1) {
+            job->cancelled.store(1);
+        }
+    }
+    jobsRetired.wakeAll();
+}
+
+bool LoadQueue::commit(QSharedPointer<LoadJob> job, Image *img) {
+    QMutexLocker locker(&mutex);
+    running.removeOne(job);
+    jobsRetired.wakeAll();
+    if(job->isCancelled() || cache->isLoaded(job->path)) {
+        return false;
+    }
+    cache->setImage(img, job->path);
+    return true;
+}
+
+void LoadQueue::discard(QSharedPointer<LoadJob> job) {
+    QMutexLocker locker(&mutex);
+    running.removeOne(job);
+    jobsRetired.wakeAll();
+}
+
+void LoadQueue::waitForHigherPriority(LoadPriority priority, int timeout) {
+    QMutexLocker locker(&mutex);
+    QElapsedTimer timer;
+    timer.start();
+    while(hasPending(priority)) {
+        qint64 timeLeft = timeout - timer.elapsed();
+        if(timeLeft <= 0 || !jobsRetired.wait(&mutex, timeLeft))
+            break;
+    }
+}
+
+// ##############################################################
+// ###################### PRIVATE METHODS #######################
+// ##############################################################
+
+// cancelled jobs still occupy a worker until they reach a checkpoint,
+// but they do not count as running preloads
+bool LoadQueue::canStart(QSharedPointer<LoadJob> job) {
+    if(job->priority == PRIORITY_CURRENT) {
+        return true;
+    }
+    bool currentRunning = false;
+    int preloads = 0;
+    for(int i = 0; i < running.count(); i++) {
+        QSharedPointer<LoadJob> other = running.at(i);
+        if(other->isCancelled())
+            continue;
+        if(other->priority == PRIORITY_CURRENT)
+            currentRunning = true;
+        else
+            preloads++;
+    }
+    // keep one worker free for the current image unless it is already running
+    int freeWorkers = workerCount - running.count();
+    if(!currentRunning && freeWorkers <= 1) {
+        return false;
+    }
+    return freeWorkers > 0 && preloads < workerCount - 1;
+}
+
+bool LoadQueue::hasPending(LoadPriority priority) {
+    for(int i = 0; i < queued.count(); i++) {
+        if(queued.at(i)->priority < priority)
+            return true;
+    }
+    for(int i = 0; i < running.count(); i++) {
+        if(running.at(i)->priority < priority && !running.at(i)->isCancelled())
+            return true;
+    }
+    return false;
+}
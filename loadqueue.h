@@ -0,0 +1,86 @@
+#ifndef LOADQUEUE_H
+#define LOADQUEUE_H
+
+#include <QList>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QElapsedTimer>
+#include <QSharedPointer>
+#include <QAtomicInt>
+#include <QString>
+#include <QVector>
+#include "imagecache.h"
+
+// lower value = higher priority
+enum LoadPriority { PRIORITY_CURRENT, PRIORITY_PRELOAD, PRIORITY_THUMBNAIL };
+
+class LoadJob {
+public:
+    LoadJob(int _pos, QString _path, LoadPriority _priority, FileFormat _format);
+    int pos;
+    QString path;
+    // null if not sniffed yet
+    FileFormat format;
+    LoadPriority priority;
+
+    // can be called from any thread
+    // workers check it between decoding stages
+    bool isCancelled() const;
+
+private:
+    friend class LoadQueue;
+    QAtomicInt cancelled;
+};
+
+class LoadQueue {
+public:
+    LoadQueue(ImageCache *_cache);
+
+    // number of workers taking jobs from the queue.
+    // Other jobs never take the last free worker,
+    // so current image does not wait behind them
+    void setWorkerCount(int count);
+
+    // ignored if position is already queued or running
+    // in that case job gets the higher of two priorities
+    void push(int pos, QString path, LoadPriority priority, FileFormat format = FileFormat());
+
+    // returns next job to run, or null when there is nothing to do
+    QSharedPointer<LoadJob> take();
+
+    // cancels queued and running jobs for every position not in the list
+    void cancelExcept(const QList<int> &positions);
+    void cancelAll();
+
+    // a file was inserted (delta 1) or removed (delta -1) at pos.
+    // Jobs follow their files, the job of a removed file is cancelled
+    void shiftPositions(int pos, int delta);
+    // same for a new file list; moved[old position] = new position or -1
+    void remap(const QVector<int> &moved);
+
+    // puts decoded image into cache and retires the job.
+    // The image goes to the job's file, wherever it is in the list now.
+    // Cancelled jobs and jobs for already loaded files are rejected,
+    // their image is not touched. serialized with cancellation, so
+    // a job cancelled before this call never reaches the cache
+    bool commit(QSharedPointer<LoadJob> job, Image *img);
+
+    // retires a job without result
+    void discard(QSharedPointer<LoadJob> job);
+
+    // blocks while there are pending jobs with higher priority,
+    // but no longer than timeout (ms)
+    void waitForHigherPriority(LoadPriority priority, int timeout);
+
+private:
+    ImageCache *cache;
+    QList< QSharedPointer<LoadJob> > queued, running;
+    int workerCount;
+    QMutex mutex;
+    QWaitCondition jobsRetired;
+
+    bool canStart(QSharedPointer<LoadJob> job);
+    bool hasPending(LoadPriority priority);
+};
+
+#endif // LOADQUEUE_H
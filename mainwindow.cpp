@@ -129,12 +129,24 @@ void MainWindow::enablePanel() {
     connect(panel, SIGNAL(thumbnailRequested(int)),
             core, SIGNAL(thumbnailRequested(int)), Qt::UniqueConnection);
 
+    connect(panel, SIGNAL(thumbnailRangeChanged(int, int)),
+            core, SIGNAL(thumbnailRangeChanged(int, int)), Qt::UniqueConnection);
+
     connect(core, SIGNAL(thumbnailReady(int, Thumbnail *)),
             panel, SLOT(setThumbnail(int, Thumbnail *)), Qt::UniqueConnection);
 
     connect(core, SIGNAL(cacheInitialized(int)),
             panel, SLOT(fillPanel(int)), static_cast<Qt::ConnectionType>(Qt::DirectConnection | Qt::UniqueConnection));
 
+    connect(core, SIGNAL(fileAdded(int)),
+            panel, SLOT(insertItem(int)), Qt::UniqueConnection);
+
+    connect(core, SIGNAL(fileRemoved(int)),
+            panel, SLOT(removeItem(int)), Qt::UniqueConnection);
+
+    connect(core, SIGNAL(fileListReordered(QVector<int>, int)),
+            panel, SLOT(reorderItems(QVector<int>, int)), Qt::UniqueConnection);
+
     connect(panel, SIGNAL(panelSizeChanged()),
                this, SLOT(calculatePanelTriggerArea()), Qt::UniqueConnection);
 
@@ -164,12 +176,24 @@ void MainWindow::disablePanel() {
     disconnect(panel, SIGNAL(thumbnailRequested(int)),
             core, SIGNAL(thumbnailRequested(int)));
 
+    disconnect(panel, SIGNAL(thumbnailRangeChanged(int, int)),
+            core, SIGNAL(thumbnailRangeChanged(int, int)));
+
     disconnect(core, SIGNAL(thumbnailReady(int, Thumbnail *)),
             panel, SLOT(setThumbnail(int, Thumbnail *)));
 
     disconnect(core, SIGNAL(cacheInitialized(int)),
             panel, SLOT(fillPanel(int)));
 
+    disconnect(core, SIGNAL(fileAdded(int)),
+            panel, SLOT(insertItem(int)));
+
+    disconnect(core, SIGNAL(fileRemoved(int)),
+            panel, SLOT(removeItem(int)));
+
+    disconnect(core, SIGNAL(fileListReordered(QVector<int>, int)),
+            panel, SLOT(reorderItems(QVector<int>, int)));
+
     disconnect(panel, SIGNAL(panelSizeChanged()),
                this, SLOT(calculatePanelTriggerArea()));
 
@@ -195,15 +219,21 @@ void MainWindow::enableImageViewer() {
         connect(imageViewer, SIGNAL(scalingRequested(QSize)),
                 core, SLOT(rescaleForZoom(QSize)), Qt::UniqueConnection);
 
-        connect(core, SIGNAL(scalingFinished(QPixmap *)),
-                imageViewer, SLOT(updateImage(QPixmap *)), Qt::UniqueConnection);
+        connect(core, SIGNAL(scalingFinished(QImage)),
+                imageViewer, SLOT(updateImage(QImage)), Qt::UniqueConnection);
+
+        connect(imageViewer, SIGNAL(sourceRequested()),
+                core, SLOT(requestSourceImage()), Qt::UniqueConnection);
 
-        connect(core, SIGNAL(frameChanged(QPixmap *)),
-                imageViewer, SLOT(updateImage(QPixmap *)),
+        connect(core, SIGNAL(sourceImageReady(QImage)),
+                imageViewer, SLOT(setSourceImage(QImage)), Qt::UniqueConnection);
+
+        connect(core, SIGNAL(frameChanged(QImage)),
+                imageViewer, SLOT(updateImage(QImage)),
                 static_cast<Qt::ConnectionType>(Qt::DirectConnection | Qt::UniqueConnection));
         // reload after image edits
-        connect(core, SIGNAL(imageAltered(QPixmap *)),
-                imageViewer, SLOT(displayImage(QPixmap *)), Qt::UniqueConnection);
+        connect(core, SIGNAL(imageAltered(QImage)),
+                imageViewer, SLOT(displayImage(QImage)), Qt::UniqueConnection);
 
         connect(core, SIGNAL(videoAltered(Clip *)),
                 videoPlayer, SLOT(displayVideo(Clip *)), Qt::UniqueConnection);
@@ -214,8 +244,8 @@ void MainWindow::enableImageViewer() {
         connect(imageViewer, SIGNAL(wallpaperSelected(QRect)),
                 core, SLOT(setWallpaper(QRect)), Qt::UniqueConnection);
 
-        connect(core, SIGNAL(signalSetImage(QPixmap *)),
-                this, SLOT(openImage(QPixmap *)), Qt::UniqueConnection);
+        connect(core, SIGNAL(signalSetImage(QImage, QSize)),
+                this, SLOT(openImage(QImage, QSize)), Qt::UniqueConnection);
 
         connect(this, SIGNAL(signalFitAll()),
                 imageViewer, SLOT(slotFitAll()), Qt::UniqueConnection);
@@ -243,14 +273,17 @@ void MainWindow::disableImageViewer() {
     disconnect(imageViewer, SIGNAL(scalingRequested(QSize)),
                core, SLOT(rescaleForZoom(QSize)));
 
+    disconnect(imageViewer, SIGNAL(sourceRequested()),
+               core, SLOT(requestSourceImage()));
+
     disconnect(imageViewer, SIGNAL(cropSelected(QRect)),
                core, SLOT(crop(QRect)));
 
     disconnect(imageViewer, SIGNAL(wallpaperSelected(QRect)),
                core, SLOT(setWallpaper(QRect)));
 
-    disconnect(core, SIGNAL(signalSetImage(QPixmap *)),
-               imageViewer, SLOT(displayImage(QPixmap *)));
+    disconnect(core, SIGNAL(signalSetImage(QImage, QSize)),
+               this, SLOT(openImage(QImage, QSize)));
 
     disconnect(this, SIGNAL(signalZoomIn()),
                imageViewer, SLOT(slotZoomIn()));
@@ -294,9 +327,9 @@ void MainWindow::open(QString path) {
     core->loadImageBlocking(path);
 }
 
-void MainWindow::openImage(QPixmap *pixmap) {
+void MainWindow::openImage(QImage image, QSize realSize) {
     enableImageViewer();
-    imageViewer->displayImage(pixmap);
+    imageViewer->displayImage(image, realSize);
 }
 
 void MainWindow::readSettingsInitial() {
@@ -81,7 +81,7 @@ private slots:
     void slotShowControls(bool);
     void slotShowInfo(bool x);
     void openVideo(Clip *clip);
-    void openImage(QPixmap *pixmap);
+    void openImage(QImage image, QSize realSize);
     void showSettings();
 
     void slotSelectWallpaper();
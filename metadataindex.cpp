@@ -0,0 +1,228 @@
+#include "metadataindex.h"
+
+FileFormat ImageMetadata::format() const {
+    FileFormat format;
+    format.mimeType = mimeType;
+    format.animated = animated;
+    return format;
+}
+
+// Reads one file, runs in the index pool.
+// The file is read once; format, size and EXIF come from that buffer.
+// The jpeg APP1 segment is at most 64 KB, so the size (SOF) is
+// usually within HEAD_SIZE too
+struct MetadataReader {
+    MetadataReader(QString _dirPath) : dirPath(_dirPath) {
+    }
+    typedef ImageMetadata result_type;
+    ImageMetadata operator()(const FileEntry &entry) {
+        ImageMetadata metadata;
+        metadata.name = entry.name;
+        metadata.modified = entry.modified;
+        metadata.fileSize = entry.size;
+        QFile file(dirPath + "/" + entry.name);
+        if(!file.open(QIODevice::ReadOnly)) {
+            return metadata;
+        }
+        QByteArray head = file.read(HEAD_SIZE);
+        FileFormat format = entry.format.isNull() ?
+                    FormatSniffer::format(head.left(FormatSniffer::HEADER_SIZE)) : entry.format;
+        metadata.mimeType = format.mimeType;
+        metadata.animated = format.animated;
+        if(metadata.mimeType.startsWith("image/")) {
+            QBuffer buffer(&head);
+            buffer.open(QIODevice::ReadOnly);
+            metadata.size = QImageReader(&buffer).size();
+            // header did not fit
+            if(!metadata.size.isValid() && head.size() == HEAD_SIZE && file.seek(0)) {
+                metadata.size = QImageReader(&file).size();
+            }
+        }
+        if(metadata.mimeType == "image/jpeg") {
+            QBuffer buffer(&head);
+            buffer.open(QIODevice::ReadOnly);
+            ExifReader exif(&buffer);
+            metadata.orientation = exif.orientation();
+            metadata.dateTaken = exif.dateTaken();
+        }
+        return metadata;
+    }
+    QString dirPath;
+    static const int HEAD_SIZE = 128 * 1024;
+};
+
+MetadataIndex::MetadataIndex(QThreadPool *_pool, QObject *parent) :
+    QObject(parent),
+    modified(false),
+    pool(_pool),
+    readCount(0)
+{
+    watcher = new QFutureWatcher<ImageMetadata>(this);
+    connect(watcher, SIGNAL(resultsReadyAt(int, int)),
+            this, SLOT(onResults(int, int)));
+    connect(watcher, SIGNAL(finished()), this, SLOT(onFinished()));
+}
+
+MetadataIndex::~MetadataIndex() {
+    stop();
+    watcher->waitForFinished();
+    save();
+}
+
+// ##############################################################
+// ####################### PUBLIC METHODS #######################
+// ##############################################################
+
+bool MetadataIndex::update(QString dir, const QList<FileEntry> &files) {
+    stop();
+    if(dir != currentDir) {
+        save();
+        currentDir = dir;
+        load();
+    }
+    QHash<QString, ImageMetadata> valid;
+    QList<FileEntry> missing;
+    for(int i = 0; i < files.count(); i++) {
+        const FileEntry &entry = files.at(i);
+        QHash<QString, ImageMetadata>::iterator metadata = entries.find(entry.name);
+        if(metadata != entries.end() &&
+           metadata->modified == entry.modified &&
+           metadata->fileSize == entry.size)
+        {
+            valid.insert(entry.name, *metadata);
+        } else {
+            missing.append(entry);
+        }
+    }
+    if(valid.count() != entries.count()) {
+        modified = true;
+    }
+    entries = valid;
+    if(missing.isEmpty()) {
+        save();
+        return true;
+    }
+    readCount = missing.count();
+    watcher->setFuture(mappedOnPool(pool, missing, MetadataReader(currentDir), READ_CHUNK));
+    return false;
+}
+
+bool MetadataIndex::lookup(QString fileName, ImageMetadata &metadata) {
+    QHash<QString, ImageMetadata>::iterator entry = entries.find(fileName);
+    if(entry == entries.end()) {
+        return false;
+    }
+    metadata = *entry;
+    return true;
+}
+
+bool MetadataIndex::isRunning() {
+    return watcher->isRunning();
+}
+
+// Results that are ready but were not delivered to onResults() yet
+// are taken from the future directly; a cancelled watcher drops them
+void MetadataIndex::stop() {
+    if(!watcher->isRunning()) {
+        return;
+    }
+    QFuture<ImageMetadata> future = watcher->future();
+    for(int i = 0; i < readCount; i++) {
+        if(future.isResultReadyAt(i)) {
+            ImageMetadata metadata = future.resultAt(i);
+            entries.insert(metadata.name, metadata);
+            modified = true;
+        }
+    }
+    watcher->cancel();
+}
+
+// written to a temporary file first, then renamed into place
+void MetadataIndex::save() {
+    if(!modified || currentDir.isEmpty()) {
+        return;
+    }
+    modified = false;
+    QString path = indexPath();
+    if(!QDir().mkpath(QFileInfo(path).absolutePath())) {
+        return;
+    }
+    QTemporaryFile tmp(path + "-XXXXXX");
+    if(!tmp.open()) {
+        return;
+    }
+    QDataStream out(&tmp);
+    out << INDEX_MAGIC << INDEX_VERSION << currentDir << (quint32)entries.count();
+    for(QHash<QString, ImageMetadata>::iterator i = entries.begin(); i != entries.end(); ++i) {
+        out << i->name << i->modified << i->fileSize
+            << i->mimeType << i->animated << i->size
+            << (qint32)i->orientation << i->dateTaken;
+    }
+    if(out.status() != QDataStream::Ok) {
+        return;
+    }
+    tmp.close();
+    QFile::remove(path);
+    if(tmp.rename(path)) {
+        tmp.setAutoRemove(false);
+    }
+}
+
+// ##############################################################
+// ####################### PRIVATE METHODS ######################
+// ##############################################################
+
+QString MetadataIndex::indexPath() {
+    QByteArray hash = QCryptographicHash::hash(currentDir.toUtf8(), QCryptographicHash::Md5).toHex();
+    return QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation) +
+           "/qimgv/metadata/" + QString::fromLatin1(hash) + ".index";
+}
+
+// a missing or broken index reads as empty
+void MetadataIndex::load() {
+    entries.clear();
+    modified = false;
+    QFile file(indexPath());
+    if(!file.open(QIODevice::ReadOnly)) {
+        return;
+    }
+    QDataStream in(&file);
+    quint32 magic, version, count;
+    QString dir;
+    in >> magic >> version >> dir >> count;
+    if(magic != INDEX_MAGIC || version != INDEX_VERSION || dir != currentDir) {
+        return;
+    }
+    entries.reserve(count);
+    for(quint32 i = 0; i < count && in.status() == QDataStream::Ok; i++) {
+        ImageMetadata metadata;
+        qint32 orientation;
+        in >> metadata.name >> metadata.modified >> metadata.fileSize
+           >> metadata.mimeType >> metadata.animated >> metadata.size
+           >> orientation >> metadata.dateTaken;
+        metadata.orientation = orientation;
+        if(in.status() == QDataStream::Ok) {
+            entries.insert(metadata.name, metadata);
+        }
+    }
+}
+
+// ##############################################################
+// ###################### PRIVATE SLOTS #########################
+// ##############################################################
+
+void MetadataIndex::onResults(int begin, int end) {
+    for(int i = begin; i < end; i++) {
+        ImageMetadata metadata = watcher->resultAt(i);
+        entries.insert(metadata.name, metadata);
+    }
+    modified = true;
+}
+
+void MetadataIndex::onFinished() {
+    if(watcher->isCanceled()) {
+        return;
+    }
+    save();
+    emit finished();
+}
@@ -0,0 +1,93 @@
+#ifndef METADATAINDEX_H
+#define METADATAINDEX_H
+
+#include <QObject>
+#include <QHash>
+#include <QSize>
+#include <QFile>
+#include <QDir>
+#include <QDataStream>
+#include <QDateTime>
+#include <QImageReader>
+#include <QBuffer>
+#include <QTemporaryFile>
+#include <QStandardPaths>
+#include <QCryptographicHash>
+#include <QFutureWatcher>
+#include <QtConcurrent>
+#include <QThreadPool>
+#include "fileentry.h"
+#include "formatsniffer.h"
+#include "lib/exifreader.h"
+#include "lib/poolmap.h"
+
+// what is known about a file without decoding it
+class ImageMetadata {
+public:
+    ImageMetadata() : fileSize(0), animated(false), orientation(1) {
+    }
+    QString name;
+    // of the file when it was read; a mismatch means the entry is stale
+    QDateTime modified;
+    qint64 fileSize;
+    QString mimeType;
+    bool animated;
+    // as stored in the file; decoded images are not rotated either
+    QSize size;
+    // EXIF values, jpeg only
+    int orientation;
+    QDateTime dateTaken;
+
+    FileFormat format() const;
+};
+
+// Header data of every file in a directory.
+// Missing and stale entries are read in the given pool (format sniff,
+// QImageReader::size(), EXIF); nothing is decoded.
+// The index is kept in ~/.cache/qimgv/metadata/<md5 of directory>.index,
+// so the next visit only reads files that changed.
+class MetadataIndex : public QObject
+{
+    Q_OBJECT
+public:
+    explicit MetadataIndex(QThreadPool *_pool, QObject *parent = 0);
+    ~MetadataIndex();
+
+    // switches to dir if needed, drops entries of files that are
+    // not in the list and starts reading the missing ones.
+    // Returns true if nothing was missing; finished() is not emitted then
+    bool update(QString dir, const QList<FileEntry> &files);
+    // false if the file is not indexed yet
+    bool lookup(QString fileName, ImageMetadata &metadata);
+    bool isRunning();
+    // cancels reading; entries read so far are kept
+    void stop();
+    void save();
+
+signals:
+    // all files from the last update() are indexed
+    void finished();
+
+private:
+    QString currentDir;
+    QHash<QString, ImageMetadata> entries;
+    bool modified;
+    QFutureWatcher<ImageMetadata> *watcher;
+    QThreadPool *pool;
+    // files passed to the running read
+    int readCount;
+
+    void load();
+    QString indexPath();
+
+    const int READ_CHUNK = 32;
+
+    const quint32 INDEX_MAGIC = 0x514D4931;
+    const quint32 INDEX_VERSION = 1;
+
+private slots:
+    void onResults(int begin, int end);
+    void onFinished();
+};
+
+#endif // METADATAINDEX_H
@@ -4,23 +4,39 @@
 
 NewLoader::NewLoader(DirectoryManager *_dm) :
     reduceRam(false),
-    current(NULL),
-    preloadTarget(0),
-    loadTarget(-1)
+    usePreloader(true),
+    loadTarget(-1),
+    currentPos(-1),
+    direction(1),
+    preloadAhead(3),
+    preloadBehind(1),
+    thumbnailRangeFirst(-1),
+    thumbnailRangeLast(-1)
 {
     dm = _dm;
-    loadThread = new QThread(this);
+    displaySize = QApplication::desktop()->screenGeometry().size();
+    thumbnailCache = new ThumbnailCache();
+    thumbnailPack = new ThumbnailPack();
+    thumbnailPool = new QThreadPool(this);
+    thumbnailPool->setMaxThreadCount(qMax(2, QThread::idealThreadCount()));
+    int threadCount = qBound(2, QThread::idealThreadCount() / 2, MAX_LOAD_THREADS);
+    for(int i = 0; i < threadCount; i++) {
+        loadThreads.append(new QThread(this));
+    }
     readSettings();
    //QPixmapCache::setCacheLimit(20480);
-    QThreadPool::globalInstance()->setMaxThreadCount(4);
     connect(settings, SIGNAL(settingsChanged()),
             this, SLOT(readSettings()));
+    connect(qApp, SIGNAL(aboutToQuit()),
+            this, SLOT(flushThumbnails()));
+    connect(dm, SIGNAL(fileAdded(int)), this, SLOT(onFileAdded(int)));
+    connect(dm, SIGNAL(fileRemoved(int)), this, SLOT(onFileRemoved(int)));
+    connect(dm, SIGNAL(fileListChanged()), this, SLOT(onFileListChanged()));
 }
 
 void NewLoader::open(QString path) {
     if(!dm->existsInCurrentDir(path)) {
         freeAll();
-        preloadTarget = 0;
         loadTarget = 0;
         dm->setFile(path);
         reinitCache();
@@ -41,19 +57,23 @@ void NewLoader::openBlocking(QString path) {
         dm->setFile(path);
     }
     emit loadStarted();
-    //ugly shit
     int target = dm->currentFilePos();
     setLoadTarget(target);
-    LoadHelper *localWorker = new LoadHelper(cache, thread());
-    worker->setTarget(target, dm->currentFilePath());
-    localWorker->setTarget(target, dm->currentFilePath());
-    localWorker->doLoad();
+    queue->cancelAll();
+    if(!cache->isLoaded(target)) {
+        ImageFactory *factory = new ImageFactory(displaySize);
+        cache->setImage(factory->createImage(dm->currentFilePath(), dm->formatAt(target)), target);
+        delete factory;
+    }
     onLoadFinished(target);
-    delete localWorker;
+    schedulePreload();
+    dispatch();
 }
 
 void NewLoader::open(int pos) {
+    int oldPos = dm->currentFilePos();
     if(dm->setCurrentPos(pos)) {
+        direction = (pos < oldPos) ? -1 : 1;
         emit loadStarted();
         doLoad(dm->currentFilePos());
         freeAuto();
@@ -62,17 +82,63 @@ void NewLoader::open(int pos) {
 
 void NewLoader::doLoad(int pos) {
     setLoadTarget(pos);
-    if(!cache->isLoaded(pos)) {
-        preloadTimer->stop();
+    schedulePreload();
+    if(!cache->lookup(pos)) {
         loadTimer->start(loadTimer->isActive() ? LOAD_DELAY : 0);
     } else {
-        emit onLoadFinished(pos);
+        onLoadFinished(pos);
+        dispatch();
     }
 }
 
-void NewLoader::doPreload() {
-    if(!cache->isLoaded(preloadTarget)) {
-        preloadTimer->start(200);
+// load target after a change of the file list. Not a navigation,
+// so it is not counted as a cache access
+void NewLoader::reload() {
+    schedulePreload();
+    if(!cache->isLoaded(loadTarget)) {
+        loadTimer->start(loadTimer->isActive() ? LOAD_DELAY : 0);
+    } else {
+        onLoadFinished(loadTarget);
+        dispatch();
+    }
+}
+
+// builds the list of images to preload around current position
+// nearest images in browsing direction go first
+void NewLoader::schedulePreload() {
+    preloadTargets.clear();
+    if(!usePreloader) {
+        return;
+    }
+    for(int i = 1; i <= preloadAhead; i++) {
+        int pos = (direction > 0) ? dm->peekNext(i) : dm->peekPrev(i);
+        if(pos != loadTarget && !preloadTargets.contains(pos))
+            preloadTargets.append(pos);
+    }
+    for(int i = 1; i <= preloadBehind; i++) {
+        int pos = (direction > 0) ? dm->peekPrev(i) : dm->peekNext(i);
+        if(pos != loadTarget && !preloadTargets.contains(pos))
+            preloadTargets.append(pos);
+    }
+}
+
+// drops jobs for images that are no longer needed,
+// then queues current image and preloads
+void NewLoader::dispatch() {
+    QList<int> wanted = preloadTargets;
+    wanted.prepend(loadTarget);
+    queue->cancelExcept(wanted);
+    if(!cache->isLoaded(loadTarget)) {
+        queue->push(loadTarget, dm->filePathAt(loadTarget), PRIORITY_CURRENT, dm->formatAt(loadTarget));
+    }
+    for(int i = 0; i < preloadTargets.count(); i++) {
+        int pos = preloadTargets.at(i);
+        if(!cache->isLoaded(pos)) {
+            queue->push(pos, dm->filePathAt(pos), PRIORITY_PRELOAD, dm->formatAt(pos));
+        }
+    }
+    for(int i = 0; i < workers.count(); i++) {
+        QMetaObject::invokeMethod(workers.at(i), "doLoad", Qt::QueuedConnection);
     }
 }
 
@@ -80,8 +146,8 @@ void NewLoader::loadNext() {
     QMutexLocker locker(&mutex);
     if(dm->peekNext(1) != dm->currentFilePos()) {
         if(setLoadTarget(dm->nextPos())) {
+            direction = 1;
             emit loadStarted();
-            preloadTarget = dm->peekNext(1);
             doLoad(loadTarget);
             freeAuto();
         }
@@ -92,8 +158,8 @@ void NewLoader::loadPrev() {
     QMutexLocker locker(&mutex);
     if(dm->peekPrev(1) != dm->currentFilePos()) {
         if(setLoadTarget(dm->prevPos())) {
+            direction = -1;
             emit loadStarted();
-            preloadTarget = dm->peekPrev(1);
             doLoad(loadTarget);
             freeAuto();
         }
@@ -101,70 +167,45 @@ void NewLoader::loadPrev() {
 }
 
 void NewLoader::onLoadFinished(int loaded) {
-    startPreload();
-    if(loaded == loadTarget && current != cache->imageAt(loaded)) {
-        emit loadFinished(cache->imageAt(loaded), loaded);
-        current = cache->imageAt(loaded);
-    } else if(isRelevant(loaded)) {
-        //qDebug() << "loadfinished image is relevant, keeping.." << loaded;
-    } else {
-        cache->unloadAt(loaded);
-        //qDebug() << "load finished but not relevant ("<< loaded <<"). deleting..";
+    QSharedPointer<Image> img = cache->imageAt(loaded);
+    if(loaded == loadTarget && img && current != img) {
+        emit loadFinished(img, loaded);
+        current = img;
+        currentPos = loaded;
     }
+    // everything else stays in cache while it fits into the budget
+    freeAuto();
 }
 
-bool NewLoader::isRelevant(int pos) {
-    return !(pos < loadTarget - 1 || pos > loadTarget + 1);
+// only passed on while the full image is still on its way
+void NewLoader::onPreviewReady(QString path, QImage preview, QSize realSize) {
+    if(isLoadTarget(path) && !cache->isLoaded(loadTarget)) {
+        emit previewReady(preview, realSize, loadTarget);
+    }
 }
 
-void NewLoader::onLoadTimeout() {
-    mutex.lock();
-    if(loadTarget != worker->target()) {
-        worker->setTarget(loadTarget, dm->filePathAt(loadTarget));
-        emit startLoad();
-    }
-    mutex.unlock();
+// only the load target is shown, everything else just counts for the budget
+void NewLoader::onJobFinished(QString path) {
+    onLoadFinished(isLoadTarget(path) ? loadTarget : -1);
 }
 
-void NewLoader::onPreloadTimeout() {
-    mutex.lock();
-    if(isRelevant(preloadTarget)) {
-        worker->setTarget(preloadTarget, dm->filePathAt(preloadTarget));
-        //qDebug()<< "PRELOAD " << worker->target();
-        emit startLoad();
-    }
-    mutex.unlock();
+bool NewLoader::isLoadTarget(QString path) {
+    return loadTarget != -1 && dm->filePathAt(loadTarget) == path;
 }
 
+// keeps cache within the memory budget
 void NewLoader::freeAuto() {
-    for(int i = 0; i < cache->length(); i++) {
-        if(!isRelevant(i) && cache->isLoaded(i)) {
-            bool flag = false;
-            if(cache->imageAt(i) == current) {
-                flag = true;
-            }
-            //qDebug() <<"!!unloading: " << i;
-            cache->unloadAt(i);
-            if(flag)
-                current = NULL;
-        }
+    QList<int> unloaded = cache->shrink(loadTarget);
+    if(unloaded.contains(currentPos)) {
+        current.clear();
+        currentPos = -1;
     }
 }
 
 void NewLoader::freeAll() {
     cache->unloadAll();
-    current = NULL;
-}
-
-void NewLoader::freeAt(int toUnload) {
-    if(!isRelevant(toUnload)) {
-        //qDebug() << "!!!deleting" << toUnload << "  "<< cache->imageAt(toUnload);
-        if(current == cache->imageAt(toUnload)) {
-            current = NULL;
-        }
-        cache->unloadAt(toUnload);
-        //qDebug() << "image freed: "<< toUnload;
-    }
+    current.clear();
+    currentPos = -1;
 }
 
 bool NewLoader::setLoadTarget(int _target) {
@@ -182,51 +223,206 @@ const ImageCache *NewLoader::getCache() {
 void NewLoader::setCache(ImageCache *_cache) {
     this->cache = _cache;
     cache->init(dm->currentDirectory(), dm->fileList());
-    worker = new LoadHelper(cache, this->thread());
-    worker->moveToThread(loadThread);
-    connect(this, SIGNAL(startLoad()), worker, SLOT(doLoad()));
-    connect(worker, SIGNAL(finished(int)), this, SLOT(onLoadFinished(int)));
+    queue = new LoadQueue(cache);
+    queue->setWorkerCount(loadThreads.count());
+    for(int i = 0; i < loadThreads.count(); i++) {
+        LoadHelper *worker = new LoadHelper(queue, cache, this->thread(), displaySize);
+        worker->moveToThread(loadThreads.at(i));
+        connect(worker, SIGNAL(finished(QString)), this, SLOT(onJobFinished(QString)));
+        connect(worker, SIGNAL(previewReady(QString, QImage, QSize)),
+                this, SLOT(onPreviewReady(QString, QImage, QSize)));
+        workers.append(worker);
+        loadThreads.at(i)->start();
+    }
 
     loadTimer = new QTimer(this);
     loadTimer->setSingleShot(true);
-    connect(loadTimer, SIGNAL(timeout()), this, SLOT(onLoadTimeout()));
-    preloadTimer = new QTimer(this);
-    preloadTimer->setSingleShot(true);
-    if(settings->usePreloader()) {
-        connect(preloadTimer, SIGNAL(timeout()), this, SLOT(onPreloadTimeout()));
-    }
-    loadThread->start();
+    connect(loadTimer, SIGNAL(timeout()), this, SLOT(dispatch()));
 }
 
 void NewLoader::reinitCache() {
     if(cache->currentDirectory() != dm->currentDirectory()) {
+        queue->cancelAll();
+        thumbnailPack->flush();
+        thumbnailRequests.clear();
         cache->init(dm->currentDirectory(), dm->fileList());
     }
 }
 
-void NewLoader::reinitCacheForced() {
-    cache->init(dm->currentDirectory(), dm->fileList());
-}
-
 // for position in directory
 void NewLoader::generateThumbnailFor(int pos) {
-    Thumbnailer *thWorker = new Thumbnailer(cache, dm->filePathAt(pos), pos, settings->squareThumbnails());
-    connect(thWorker, SIGNAL(thumbnailReady(int,Thumbnail*)),
-            this, SIGNAL(thumbnailReady(int,Thumbnail*)));
-    thWorker->setAutoDelete(true);
-    QThreadPool::globalInstance()->start(thWorker);
-    //QtConcurrent::run(this, &NewLoader::generateThumbnailThread, pos);
+    if(!inThumbnailRange(pos)) {
+        return;
+    }
+    // back in range before the job noticed
+    if(thumbnailsRunning.contains(pos)) {
+        thumbnailsRunning.value(pos)->store(0);
+        return;
+    }
+    thumbnailRequests.removeOne(pos);
+    thumbnailRequests.append(pos);
+    startThumbnailJobs();
 }
 
-void NewLoader::readSettings() {
-    if(settings->usePreloader()) {
-        connect(this, SIGNAL(startPreload()),
-                this, SLOT(doPreload()));
+void NewLoader::setThumbnailRange(int first, int last) {
+    thumbnailRangeFirst = first;
+    thumbnailRangeLast = last;
+    for(int i = thumbnailRequests.count() - 1; i >= 0; i--) {
+        int pos = thumbnailRequests.at(i);
+        if(pos < first || pos > last) {
+            thumbnailRequests.removeAt(i);
+        }
+    }
+    QHash<int, QSharedPointer<QAtomicInt> >::iterator i;
+    for(i = thumbnailsRunning.begin(); i != thumbnailsRunning.end(); ++i) {
+        if(!inThumbnailRange(i.key())) {
+            i.value()->store(1);
+        }
+    }
+}
+
+bool NewLoader::inThumbnailRange(int pos) {
+    return pos >= thumbnailRangeFirst && pos <= thumbnailRangeLast;
+}
+
+// keeps at most one job per pool thread in flight,
+// so the rest of requests can still be dropped or reordered
+void NewLoader::startThumbnailJobs() {
+    while(thumbnailsRunning.count() < thumbnailPool->maxThreadCount() &&
+          !thumbnailRequests.isEmpty())
+    {
+        int pos = thumbnailRequests.takeLast();
+        if(!inThumbnailRange(pos)) {
+            continue;
+        }
+        QSharedPointer<QAtomicInt> cancelled(new QAtomicInt(0));
+        ThumbnailStore *store = packedThumbnails ? (ThumbnailStore*) thumbnailPack : thumbnailCache;
+        Thumbnailer *thWorker = new Thumbnailer(cache, queue, store, dm->filePathAt(pos), dm->formatAt(pos),
+                                              pos, settings->squareThumbnails(), cancelled);
+        connect(thWorker, SIGNAL(thumbnailReady(int, Thumbnail*)),
+                this, SLOT(onThumbnailReady(int, Thumbnail*)));
+        thWorker->setAutoDelete(true);
+        thumbnailsRunning.insert(pos, cancelled);
+        thumbnailPool->start(thWorker);
+    }
+}
+
+void NewLoader::onThumbnailReady(int pos, Thumbnail *thumbnail) {
+    // files may have been added or removed since the request
+    if(dm->fileNameList.value(pos) != thumbnail->name) {
+        pos = dm->fileNameList.indexOf(thumbnail->name);
+    }
+    thumbnailsRunning.remove(pos);
+    if(pos != -1 && thumbnail->image) {
+        emit thumbnailReady(pos, thumbnail);
     } else {
-        disconnect(this, SIGNAL(startPreload()),
-                   this, SLOT(doPreload()));
+        // cancelled, but the item came back meanwhile
+        if(pos != -1 && inThumbnailRange(pos) && !thumbnailRequests.contains(pos)) {
+            thumbnailRequests.append(pos);
+        }
+        delete thumbnail;
+    }
+    startThumbnailJobs();
+}
+
+// ignored until the cache is set up for the new directory
+void NewLoader::onFileAdded(int pos) {
+    if(cache->currentDirectory() != dm->currentDirectory()) {
+        return;
+    }
+    queue->shiftPositions(pos, 1);
+    cache->insertAt(pos, dm->filePathAt(pos));
+    shiftPositions(pos, 1);
+    if(loadTarget != -1) {
+        reload();
+    }
+    emit fileAdded(pos);
+}
+
+void NewLoader::onFileRemoved(int pos) {
+    if(cache->currentDirectory() != dm->currentDirectory()) {
+        return;
+    }
+    queue->shiftPositions(pos, -1);
+    cache->removeAt(pos);
+    if(pos == currentPos) {
+        current.clear();
+    }
+    shiftPositions(pos, -1);
+    if(loadTarget != -1) {
+        reload();
+    }
+    // if it was the current file Core decides what to open next
+    emit fileRemoved(pos);
+}
+
+// the whole list was replaced (background listing finished).
+// Loaded images and running jobs follow their files
+void NewLoader::onFileListChanged() {
+    if(cache->currentDirectory() != dm->currentDirectory()) {
+        return;
+    }
+    QVector<int> moved = cache->reorder(dm->fileList());
+    queue->remap(moved);
+    mapPositions([&moved](int value) {
+        return moved.value(value, -1);
+    });
+    if(currentPos == -1) {
+        current.clear();
+    }
+    if(loadTarget != -1) {
+        reload();
+    }
+    emit fileListChanged(moved, currentPos);
+}
+
+void NewLoader::shiftPositions(int pos, int delta) {
+    mapPositions([pos, delta](int value) {
+        if(delta < 0 && value == pos) {
+            return -1;
+        }
+        return (value >= pos) ? value + delta : value;
+    });
+}
+
+void NewLoader::mapPositions(const std::function<int(int)> &map) {
+    if(loadTarget != -1) {
+        loadTarget = map(loadTarget);
     }
+    if(currentPos != -1) {
+        currentPos = map(currentPos);
+    }
+    QList<int> requests;
+    for(int i = 0; i < thumbnailRequests.count(); i++) {
+        int request = map(thumbnailRequests.at(i));
+        if(request != -1) {
+            requests.append(request);
+        }
+    }
+    thumbnailRequests = requests;
+    QHash<int, QSharedPointer<QAtomicInt> > running;
+    QHash<int, QSharedPointer<QAtomicInt> >::iterator i;
+    for(i = thumbnailsRunning.begin(); i != thumbnailsRunning.end(); ++i) {
+        int value = map(i.key());
+        if(value != -1) {
+            running.insert(value, i.value());
+        } else {
+            i.value()->store(1);
+        }
+    }
+    thumbnailsRunning = running;
+}
+
+void NewLoader::flushThumbnails() {
+    thumbnailPack->flush();
+}
+
+void NewLoader::readSettings() {
+    usePreloader = settings->usePreloader();
+    preloadAhead = settings->preloadAhead();
+    preloadBehind = settings->preloadBehind();
     reduceRam = settings->reduceRamUsage();
+    packedThumbnails = settings->packedThumbnails();
 }
 
 void NewLoader::lock() {
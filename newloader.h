@@ -8,10 +8,17 @@
 #include "sourceContainers/imagestatic.h"
 #include <QtConcurrent>
 #include <time.h>
+#include <functional>
 #include <QMutex>
 #include <QVector>
+#include <QSet>
+#include <QApplication>
+#include <QDesktopWidget>
 #include "loadhelper.h"
+#include "loadqueue.h"
 #include "thumbnailer.h"
+#include "thumbnailcache.h"
+#include "thumbnailpack.h"
 
 class NewLoader : public QObject
 {
@@ -26,33 +33,70 @@ public:
     void setCache(ImageCache*);
     void openBlocking(QString path);
     void reinitCache();
-    Image *current;
+    // displayed image; shared with the cache
+    QSharedPointer<Image> current;
 
 public slots:
-    void reinitCacheForced();
     void generateThumbnailFor(int pos);
+    // requests outside of this range are dropped
+    void setThumbnailRange(int first, int last);
 
 private:
     DirectoryManager *dm;
     ImageCache *cache;
     QMutex mutex, mutex2;
-    bool reduceRam;
-    void freeAt(int);
-    int loadTarget, preloadTarget, time;
-    LoadHelper *worker;
-    QThread *loadThread;
-    QTimer *loadTimer, *preloadTimer;
+    bool reduceRam, usePreloader;
+    int loadTarget, currentPos;
+
+    // 1 when browsing forward, -1 when browsing backwards
+    int direction;
+    int preloadAhead, preloadBehind;
+    QList<int> preloadTargets;
+
+    // images are decoded for display at no more than this size
+    QSize displaySize;
+
+    LoadQueue *queue;
+    ThumbnailCache *thumbnailCache;
+    ThumbnailPack *thumbnailPack;
+    bool packedThumbnails;
+
+    // thumbnail requests, newest last. Served LIFO
+    QThreadPool *thumbnailPool;
+    QList<int> thumbnailRequests;
+    // cancel flags of running jobs
+    QHash<int, QSharedPointer<QAtomicInt> > thumbnailsRunning;
+    // items the strip shows or preloads; nothing else gets thumbnails
+    int thumbnailRangeFirst, thumbnailRangeLast;
+    bool inThumbnailRange(int pos);
+    void startThumbnailJobs();
+    // moves stored positions after a file was inserted (delta 1)
+    // or removed (delta -1) at pos
+    void shiftPositions(int pos, int delta);
+    // replaces every stored position p with map(p), dropping -1 results
+    void mapPositions(const std::function<int(int)> &map);
+    QList<LoadHelper*> workers;
+    QList<QThread*> loadThreads;
+    QTimer *loadTimer;
 
     void freeAll();
-    bool isRelevant(int pos);
+    void schedulePreload();
+    void reload();
+    bool isLoadTarget(QString path);
 
     const int LOAD_DELAY = 0;
+    const int MAX_LOAD_THREADS = 6;
 signals:
     void loadStarted();
-    void loadFinished(Image*, int pos);
+    void loadFinished(QSharedPointer<Image>, int pos);
+    void previewReady(QImage, QSize, int pos);
     void thumbnailReady(int, Thumbnail*);
-    void startLoad();
-    void startPreload();
+    // cache was updated for a single file change in the directory
+    void fileAdded(int pos);
+    void fileRemoved(int pos);
+    // cache was reordered for a new file list; moved[old position] is
+    // the new position or -1. pos is the displayed image
+    void fileListChanged(QVector<int> moved, int pos);
 
 private slots:
     bool setLoadTarget(int);
@@ -60,11 +104,16 @@ private slots:
     void unlock();
     void readSettings();
     void doLoad(int pos);
-    void doPreload();
+    void dispatch();
     void onLoadFinished(int);
-    void onLoadTimeout();
-    void onPreloadTimeout();
+    void onJobFinished(QString path);
+    void onPreviewReady(QString path, QImage, QSize);
+    void flushThumbnails();
+    void onThumbnailReady(int, Thumbnail*);
     void freeAuto();
+    void onFileAdded(int pos);
+    void onFileRemoved(int pos);
+    void onFileListChanged();
 };
 
 #endif // NEWLOADER_H
@@ -25,17 +25,22 @@ SOURCES += main.cpp\
         mainwindow.cpp \
         overlays/infooverlay.cpp \
         fileinfo.cpp \
+        fileentry.cpp \
         overlays/controlsoverlay.cpp \
         sourceContainers/imagestatic.cpp \
         core.cpp \
         directorymanager.cpp \
+        formatsniffer.cpp \
         opendialog.cpp \
         imagecache.cpp \
         viewers/imageviewer.cpp \
+        viewers/tilecache.cpp \
         sleep.cpp \
         settings.cpp \
         settingsdialog.cpp \
         lib/imagelib.cpp \
+        lib/resampler.cpp \
+        lib/imagepyramid.cpp \
         overlays/mapoverlay.cpp \
         overlays/cropoverlay.cpp \
         thumbnailPanel/thumbnailstrip.cpp \
@@ -47,10 +52,16 @@ SOURCES += main.cpp\
         viewers/videoplayer.cpp \
         sourceContainers/video.cpp \
         loadhelper.cpp \
+        loadqueue.cpp \
         newloader.cpp \
         imagefactory.cpp \
         thumbnailer.cpp \
+        thumbnailcache.cpp \
+        thumbnailstore.cpp \
+        thumbnailpack.cpp \
+        metadataindex.cpp \
         lib/stuff.cpp \
+        lib/exifreader.cpp \
         wallpapersetter.cpp \
         actionmanager.cpp \
         customWidgets/settingsshortcutwidget.cpp \
@@ -62,16 +73,22 @@ SOURCES += main.cpp\
 HEADERS += mainwindow.h \
         overlays/infooverlay.h \
         fileinfo.h \
+        fileentry.h \
         overlays/controlsoverlay.h \
         sourceContainers/imagestatic.h \
         core.h \
         directorymanager.h \
+        formatsniffer.h \
         opendialog.h \
         imagecache.h \
         viewers/imageviewer.h \
+        viewers/tilecache.h \
         settings.h \
         settingsdialog.h \
         lib/imagelib.h \
+        lib/resampler.h \
+        lib/imagepyramid.h \
+        lib/poolmap.h \
         overlays/mapoverlay.h \
         overlays/cropoverlay.h \
         thumbnailPanel/thumbnailstrip.h \
@@ -83,11 +100,17 @@ HEADERS += mainwindow.h \
         viewers/videoplayer.h \
         sourceContainers/video.h \
         loadhelper.h \
+        loadqueue.h \
         newloader.h \
         imagefactory.h \
         thumbnailer.h \
+        thumbnailcache.h \
+        thumbnailstore.h \
+        thumbnailpack.h \
+        metadataindex.h \
         wallpapersetter.h \
         lib/stuff.h \
+        lib/exifreader.h \
         actionmanager.h \
         customWidgets/settingsshortcutwidget.h \
         sourceContainers/clip.h \
@@ -28,7 +28,7 @@ void Settings::validate() {
                                  QApplication::applicationDirPath());
         }
         // minimum cache size
-        if(settings->s.value("cacheSize").toInt() < 32) {
+        if(settings->s.contains("cacheSize") && settings->s.value("cacheSize").toInt() < 32) {
             settings->s.setValue("cacheSize", "32");
         }
 
@@ -131,18 +131,22 @@ void Settings::setPlayVideoSounds(bool mode) {
  * 1: By name reversed
  * 2: By date
  * 3: By date reversed
+ * 4: By EXIF date taken
+ * 5: By EXIF date taken reversed
+ * 6: By pixel count
+ * 7: By pixel count reversed
  */
 int Settings::sortingMode() {
     bool ok = true;
     int mode = settings->s.value("sortingMode", "0").toInt(&ok);
-    if(!ok) {
+    if(!ok || mode < 0 || mode > 7) {
         mode = 0;
     }
     return mode;
 }
 
 void Settings::setSortingMode(int mode) {
-    if(mode < 0 || mode > 3) {
+    if(mode < 0 || mode > 7) {
         qDebug() << "Invalid sorting mode (" << mode << "), resetting to default.";
         mode = 0;
     }
@@ -388,3 +392,44 @@ bool Settings::drawThumbnailSelectionBorder() {
 void Settings::setDrawThumbnailSelectionBorder(bool mode) {
     settings->s.setValue("thumbnailSelectionBorder", mode);
 }
+
+// decoded image cache budget, in MB
+int Settings::cacheSize() {
+    bool ok = true;
+    int size = settings->s.value("cacheSize", cacheSizeDefault).toInt(&ok);
+    if(!ok) {
+        size = cacheSizeDefault;
+    }
+    return size;
+}
+
+void Settings::setCacheSize(int size) {
+    settings->s.setValue("cacheSize", size);
+}
+
+// number of images decoded in advance in the browsing direction
+int Settings::preloadAhead() {
+    return qBound(0, settings->s.value("preloadAhead", 3).toInt(), 16);
+}
+
+void Settings::setPreloadAhead(int count) {
+    settings->s.setValue("preloadAhead", count);
+}
+
+// number of images kept decoded behind current one
+int Settings::preloadBehind() {
+    return qBound(0, settings->s.value("preloadBehind", 1).toInt(), 16);
+}
+
+void Settings::setPreloadBehind(int count) {
+    settings->s.setValue("preloadBehind", count);
+}
+
+// one packed file per directory instead of the shared freedesktop cache
+bool Settings::packedThumbnails() {
+    return settings->s.value("packedThumbnails", false).toBool();
+}
+
+void Settings::setPackedThumbnails(bool mode) {
+    settings->s.setValue("packedThumbnails", mode);
+}
@@ -81,10 +81,19 @@ public:
     void setSquareThumbnails(bool mode);
     bool drawThumbnailSelectionBorder();
     void setDrawThumbnailSelectionBorder(bool mode);
+    int cacheSize();
+    void setCacheSize(int size);
+    int preloadAhead();
+    void setPreloadAhead(int count);
+    int preloadBehind();
+    void setPreloadBehind(int count);
+    bool packedThumbnails();
+    void setPackedThumbnails(bool mode);
 
 private:
     explicit Settings(QObject *parent = 0);
     const int thumbnailSizeDefault = 190;
+    const int cacheSizeDefault = 512;
     QSettings s;
     QDir *tempDirectory;
 
@@ -1,11 +1,5 @@
 #include "image.h"
 
-void Image::safeDeleteSelf() {
-    mutex.lock(); // ensure we are not used
-    mutex.unlock();
-    delete this;
-}
-
 void Image::lock() {
     mutex.lock();
 }
@@ -33,3 +27,32 @@ FileInfo *Image::info() {
 void Image::attachInfo(FileInfo *_info) {
     fileInfo = _info;
 }
+
+// jpeg is downscaled while decoding, other formats get
+// a single smooth resample inside of QImageReader.
+// Images that are already small enough are not upscaled
+QImage Image::readScaled(int size, Qt::AspectRatioMode method) {
+    QImageReader reader(path, fileInfo->fileExtension());
+    QSize sourceSize = reader.size();
+    if(sourceSize.isValid()) {
+        QSize scaledSize = sourceSize.scaled(size, size, method);
+        if(scaledSize.width() < sourceSize.width()) {
+            reader.setScaledSize(scaledSize);
+        }
+        return reader.read();
+    }
+    QImage image = reader.read();
+    if(!image.isNull() && image.size().scaled(size, size, method).width() < image.width()) {
+        image = image.scaled(size, size, method, Qt::SmoothTransformation);
+    }
+    return image;
+}
+
+QPixmap *Image::cropSquare(QPixmap *pixmap, int size) {
+    QRect target(0, 0, size, size);
+    target.moveCenter(pixmap->rect().center());
+    QPixmap *thumbnail = new QPixmap(size, size);
+    *thumbnail = pixmap->copy(target);
+    delete pixmap;
+    return thumbnail;
+}
@@ -11,6 +11,7 @@
 #include <QDebug>
 #include <QPixmap>
 #include <QPixmapCache>
+#include <QImageReader>
 #include <QThread>
 #include <QMutex>
 
@@ -20,17 +21,22 @@ class Image : public QObject
 public:
     virtual QPixmap* getPixmap() = 0;
     virtual const QImage* getImage() = 0;
+    // implicitly shared handle to the decoded data, no pixel copy.
+    // Always null for videos
+    virtual QImage sharedImage() = 0;
     fileType type();
     virtual void load() = 0;
     QString getPath();
     virtual int height() = 0;
     virtual int width() = 0;
     virtual QSize size() = 0;
+
+    // approximate size of decoded data in bytes
+    virtual qint64 memoryUsage() = 0;
     bool isLoaded();
-    virtual QPixmap* generateThumbnail(bool) = 0;
+    virtual QPixmap* generateThumbnail(int size, bool squared) = 0;
     void attachInfo(FileInfo*);
     FileInfo* info();
-    void safeDeleteSelf();
 
     virtual void crop(QRect newRect) = 0;
     virtual void rotate(int grad) = 0;
@@ -45,6 +51,11 @@ protected:
     QSize resolution;
     QMutex mutex;
 
+    // decodes the file directly at thumbnail size
+    QImage readScaled(int size, Qt::AspectRatioMode method);
+    // center crop for squared thumbnails
+    QPixmap *cropSquare(QPixmap *pixmap, int size);
+
 signals:
 
 public slots:
@@ -14,6 +14,7 @@ ImageAnimated::ImageAnimated(FileInfo *_info) {
     loaded = false;
     movie = new QMovie(this);
     fileInfo = _info;
+    fileInfo->setParent(this);
     path = fileInfo->filePath();
 }
 
@@ -53,41 +54,26 @@ void ImageAnimated::save() {
     //TODO
 }
 
-QPixmap *ImageAnimated::generateThumbnail(bool squared) {
+QPixmap *ImageAnimated::generateThumbnail(int size, bool squared) {
     Qt::AspectRatioMode method = squared?(Qt::KeepAspectRatioByExpanding):(Qt::KeepAspectRatio);
-    int size = settings->thumbnailSize();
     QPixmap *tmp;
     if(!isLoaded()) {
-        tmp = new QPixmap(path, fileInfo->fileExtension());
-        *tmp = tmp->scaled(size * 2,
-                           size * 2,
-                           method,
-                           Qt::FastTransformation)
-               .scaled(size,
-                       size,
-                       method,
-                       Qt::SmoothTransformation);
+        // first frame
+        tmp = new QPixmap(QPixmap::fromImage(readScaled(size, method)));
     } else {
         tmp = new QPixmap();
         lock();
-        *tmp = movie->currentPixmap()
-               .scaled(size * 2,
-                       size * 2,
-                       method,
-                       Qt::FastTransformation)
-               .scaled(size,
-                       size,
-                       method,
-                       Qt::SmoothTransformation);
+        *tmp = movie->currentPixmap();
+        if(tmp->size().scaled(size, size, method).width() < tmp->width()) {
+            *tmp = tmp->scaled(size,
+                               size,
+                               method,
+                               Qt::SmoothTransformation);
+        }
         unlock();
     }
     if(squared) {
-        QRect target(0, 0, size, size);
-        target.moveCenter(tmp->rect().center());
-        QPixmap *thumbnail = new QPixmap(size, size);
-        *thumbnail = tmp->copy(target);
-        delete tmp;
-        return thumbnail;
+        return cropSquare(tmp, size);
     } else {
         return tmp;
     }
@@ -111,6 +97,17 @@ const QImage *ImageAnimated::getImage() {
     return cPtr;
 }
 
+// current frame
+QImage ImageAnimated::sharedImage() {
+    if(!isLoaded()) {
+        return QImage();
+    }
+    if(transform.isIdentity()) {
+        return movie->currentImage();
+    }
+    return movie->currentImage().transformed(transform, Qt::SmoothTransformation);
+}
+
 int ImageAnimated::height() {
     if(isLoaded()) {
         return movie->currentImage().height();
@@ -126,6 +123,11 @@ QSize ImageAnimated::size() {
     return isLoaded() ? movie->currentImage().size() : QSize(0, 0);
 }
 
+// only the current frame is kept decoded by QMovie
+qint64 ImageAnimated::memoryUsage() {
+    return isLoaded() ? movie->currentImage().byteCount() : 0;
+}
+
 void ImageAnimated::animationStart() {
     if(isLoaded()) {
         animationStop();
@@ -147,10 +149,8 @@ void ImageAnimated::nextFrame() {
     if(!movie->jumpToNextFrame()) {
         movie->jumpToFrame(0);
     }
-    QPixmap *newFrame = new QPixmap();
-    *newFrame = movie->currentPixmap().transformed(transform, Qt::SmoothTransformation);
     startAnimationTimer();
-    emit frameChanged(newFrame);
+    emit frameChanged(sharedImage());
 }
 
 void ImageAnimated::startAnimationTimer() {
@@ -15,12 +15,14 @@ public:
 
     QPixmap *getPixmap();
     const QImage* getImage();
+    QImage sharedImage();
     void load();
     void unload();
     int height();
     int width();
     QSize size();
-    QPixmap* generateThumbnail(bool squared);
+    qint64 memoryUsage();
+    QPixmap* generateThumbnail(int size, bool squared);
 
     void rotate(int grad);
     void crop(QRect newRect);
@@ -31,7 +33,7 @@ public slots:
     void animationStop();
 
 signals:
-    void frameChanged(QPixmap*);
+    void frameChanged(QImage);
 
 private slots:
     void nextFrame();
@@ -5,6 +5,7 @@
 ImageStatic::ImageStatic(QString _path) {
     path = _path;
     loaded = false;
+    reduced = false;
     image = NULL;
     fileInfo = new FileInfo(path, this);
     sem = new QSemaphore(1);
@@ -13,8 +14,10 @@ ImageStatic::ImageStatic(QString _path) {
 
 ImageStatic::ImageStatic(FileInfo *_info) {
     loaded = false;
+    reduced = false;
     image = NULL;
     fileInfo = _info;
+    fileInfo->setParent(this);
     path = fileInfo->filePath();
     sem = new QSemaphore(1);
     unloadRequested = false;
@@ -34,12 +37,91 @@ void ImageStatic::load() {
     if(isLoaded()) {
         return;
     }
-    image = new QImage(path, fileInfo->fileExtension());
+    QImageReader reader(path, fileInfo->fileExtension());
+    fullSize = reader.size();
+    // only jpeg scales during decoding; other handlers decode fully anyway
+    if(displaySize.isValid() && fullSize.isValid() &&
+       reader.format() == "jpeg" &&
+       reader.supportsOption(QImageIOHandler::ScaledSize) &&
+       (fullSize.width() > displaySize.width() ||
+        fullSize.height() > displaySize.height()))
+    {
+        reader.setScaledSize(fullSize.scaled(displaySize, Qt::KeepAspectRatio));
+        reduced = true;
+    }
+    image = new QImage(reader.read());
+    if(reduced && image->isNull()) {
+        delete image;
+        image = new QImage(path, fileInfo->fileExtension());
+        reduced = false;
+    }
+    if(!reduced) {
+        fullSize = image->size();
+    }
     loaded = true;
 }
 
+void ImageStatic::setDisplaySize(QSize _displaySize) {
+    displaySize = _displaySize;
+}
+
+bool ImageStatic::isReduced() {
+    return reduced;
+}
+
+// embedded exif thumbnail if there is one, 1/8 scale decode otherwise
+QImage ImageStatic::preview(QSize &realSize) {
+    QImageReader reader(path);
+    realSize = reader.size();
+    if(reader.format() != "jpeg" || !realSize.isValid() ||
+       realSize.width() * realSize.height() < PREVIEW_MIN_PIXELS)
+    {
+        return QImage();
+    }
+    QImage thumb = ExifReader(path).thumbnail();
+    // skip letterboxed thumbnails, they would look stretched
+    if(!thumb.isNull() &&
+       qAbs((float)thumb.width() / thumb.height() -
+            (float)realSize.width() / realSize.height()) < 0.05f)
+    {
+        return thumb;
+    }
+    if(!reader.supportsOption(QImageIOHandler::ScaledSize)) {
+        return QImage();
+    }
+    reader.setScaledSize(realSize / 8);
+    return reader.read();
+}
+
+// replaces reduced data with a full decode, needed for zoom and edits.
+// Decodes without holding the lock, so it can run in background
+// while the reduced copy is still in use
+void ImageStatic::loadFullResolution() {
+    QByteArray format;
+    {
+        QMutexLocker locker(&mutex);
+        if(!isLoaded() || !reduced) {
+            return;
+        }
+        format = fileInfo->fileExtension();
+    }
+    QImage *full = new QImage(path, format.constData());
+    QMutexLocker locker(&mutex);
+    // another caller got there first
+    if(full->isNull() || !isLoaded() || !reduced) {
+        delete full;
+        return;
+    }
+    delete image;
+    image = full;
+    pyramid.clear();
+    fullSize = image->size();
+    reduced = false;
+}
+
 void ImageStatic::save(QString destinationPath) {
     if(isLoaded()) {
+        loadFullResolution();
         lock();
         image->save(destinationPath);
         unlock();
@@ -48,49 +130,34 @@ void ImageStatic::save(QString destinationPath) {
 
 void ImageStatic::save() {
     if(isLoaded()) {
+        loadFullResolution();
         lock();
         image->save(path);
         unlock();
     }
 }
 
-QPixmap *ImageStatic::generateThumbnail(bool squared) {
+QPixmap *ImageStatic::generateThumbnail(int size, bool squared) {
     Qt::AspectRatioMode method = squared?(Qt::KeepAspectRatioByExpanding):(Qt::KeepAspectRatio);
-    int size = settings->thumbnailSize();
     QPixmap *tmp;
     if(!isLoaded()) {
-        tmp = new QPixmap(path, fileInfo->fileExtension());
-        *tmp = tmp->scaled(size * 2,
-                           size * 2,
-                           method,
-                           Qt::FastTransformation)
-               .scaled(size,
-                       size,
-                       method,
-                       Qt::SmoothTransformation);
+        tmp = new QPixmap(QPixmap::fromImage(readScaled(size, method)));
     } else {
         tmp = new QPixmap();
-        if(!image->isNull()) {
-            lock();
-            *tmp = QPixmap::fromImage(
-                       image->scaled(size * 2,
-                                     size * 2,
-                                     method,
-                                     Qt::FastTransformation)
-                       .scaled(size,
-                               size,
-                               method,
-                               Qt::SmoothTransformation));
-            unlock();
+        // loadFullResolution() may replace image from another thread
+        lock();
+        if(!image->isNull() && image->size().scaled(size, size, method).width() < image->width()) {
+            *tmp = QPixmap::fromImage(image->scaled(size,
+                                                    size,
+                                                    method,
+                                                    Qt::SmoothTransformation));
+        } else if(!image->isNull()) {
+            *tmp = QPixmap::fromImage(*image);
         }
+        unlock();
     }
     if(squared) {
-        QRect target(0, 0, size, size);
-        target.moveCenter(tmp->rect().center());
-        QPixmap *thumbnail = new QPixmap(size, size);
-        *thumbnail = tmp->copy(target);
-        delete tmp;
-        return thumbnail;
+        return cropSquare(tmp, size);
     } else {
         return tmp;
     }
@@ -110,20 +177,44 @@ const QImage *ImageStatic::getImage() {
     return image;
 }
 
+QImage ImageStatic::sharedImage() {
+    QMutexLocker locker(&mutex);
+    return isLoaded() ? *image : QImage();
+}
+
+QSharedPointer<ImagePyramid> ImageStatic::getPyramid() {
+    QMutexLocker locker(&mutex);
+    if(!pyramid && isLoaded()) {
+        pyramid = QSharedPointer<ImagePyramid>(new ImagePyramid(*image));
+    }
+    return pyramid;
+}
+
+// these report the file's size even when the decoded data is reduced
 int ImageStatic::height() {
-    return isLoaded() ? image->height() : 0;
+    return isLoaded() ? fullSize.height() : 0;
 }
 
 int ImageStatic::width() {
-    return isLoaded() ? image->width() : 0;
+    return isLoaded() ? fullSize.width() : 0;
 }
 
 QSize ImageStatic::size() {
-    return isLoaded() ? image->size() : QSize(0, 0);
+    return isLoaded() ? fullSize : QSize(0, 0);
+}
+
+qint64 ImageStatic::memoryUsage() {
+    QMutexLocker locker(&mutex);
+    if(!isLoaded()) {
+        return 0;
+    }
+    QSharedPointer<ImagePyramid> levels = pyramid;
+    return image->byteCount() + (levels ? levels->memoryUsage() : 0);
 }
 
 QImage *ImageStatic::rotated(int grad) {
     if(isLoaded()) {
+        loadFullResolution();
         lock();
         QImage *img = new QImage();
         QTransform transform;
@@ -141,23 +232,29 @@ void ImageStatic::rotate(int grad) {
         lock();
         delete image;
         image = img;
+        pyramid.clear();
+        fullSize = image->size();
         unlock();
     }
 }
 
 void ImageStatic::crop(QRect newRect) {
     if(isLoaded()) {
+        loadFullResolution();
         lock();
         QImage *tmp = new QImage(newRect.size(), image->format());
         *tmp = image->copy(newRect);
         delete image;
         image = tmp;
+        pyramid.clear();
+        fullSize = image->size();
         unlock();
     }
 }
 
 QImage *ImageStatic::cropped(QRect newRect, QRect targetRes, bool upscaled) {
     if(isLoaded()) {
+        loadFullResolution();
         QImage *cropped = new QImage(targetRes.size(), image->format());
         lock();
         if(upscaled) {
@@ -3,6 +3,10 @@
 
 #include "image.h"
 #include <QImage>
+#include <QImageReader>
+#include "../lib/exifreader.h"
+#include "../lib/imagepyramid.h"
+#include <QSharedPointer>
 #include <QSemaphore>
 
 class ImageStatic : public Image
@@ -13,16 +17,30 @@ public:
     ImageStatic(FileInfo *_info);
     ~ImageStatic();
 
+    // if set before load(), large images are decoded downscaled to fit this size
+    void setDisplaySize(QSize _displaySize);
+    // true if the decoded data is smaller than the file
+    bool isReduced();
+    void loadFullResolution();
+    // quick low quality version of a large jpeg, shown while load() runs.
+    // Null if the file is small or not a jpeg
+    QImage preview(QSize &realSize);
+
     QPixmap *getPixmap();
     const QImage* getImage();
+    QImage sharedImage();
+    // downscaled copies of the decoded image, built on demand.
+    // Shared so scaling jobs can keep using it after an edit or unload
+    QSharedPointer<ImagePyramid> getPyramid();
     void load();
     int height();
     int width();
     QSize size();
+    qint64 memoryUsage();
 
     QImage *rotated(int grad);
     void rotate(int grad);
-    QPixmap *generateThumbnail(bool squared);
+    QPixmap *generateThumbnail(int size, bool squared);
     QImage *cropped(QRect newRect, QRect targetRes, bool upscaled);
 
 public slots:
@@ -32,6 +50,11 @@ public slots:
 
 private:
     QImage *image;
+    QSharedPointer<ImagePyramid> pyramid;
+    QSize fullSize, displaySize;
+    bool reduced;
+
+    const int PREVIEW_MIN_PIXELS = 4000000;
     QSemaphore *sem;
     bool unloadRequested;
 };
@@ -1,6 +1,6 @@
 #include "thumbnail.h"
 
-Thumbnail::Thumbnail() {
+Thumbnail::Thumbnail() : image(NULL) {
 
 }
 
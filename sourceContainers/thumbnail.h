@@ -10,6 +10,7 @@ public:
     Thumbnail();
     ~Thumbnail();
     QString name, label;
+    // null for a cancelled job
     QPixmap *image;
 };
 
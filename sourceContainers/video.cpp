@@ -5,12 +5,15 @@
 Video::Video(QString _path) {
     path = _path;
     loaded = false;
+    clip = NULL;
     fileInfo = new FileInfo(_path, this);
 }
 
 Video::Video(FileInfo *_info) {
-    loaded = true;
+    loaded = false;
+    clip = NULL;
     fileInfo = _info;
+    fileInfo->setParent(this);
     path = fileInfo->filePath();
 }
 
@@ -47,7 +50,7 @@ void Video::save() {
     }
 }
 
-QPixmap *Video::generateThumbnail(bool squared) {
+QPixmap *Video::generateThumbnail(int size, bool squared) {
     QString ffmpegExe = settings->ffmpegExecutable();
     if(ffmpegExe.isEmpty()) {
         return thumbnailStub();
@@ -63,29 +66,18 @@ QPixmap *Video::generateThumbnail(bool squared) {
     process.close();
     if(success) {
         Qt::AspectRatioMode method = squared?(Qt::KeepAspectRatioByExpanding):(Qt::KeepAspectRatio);
-        int size = settings->thumbnailSize();
-        QPixmap *thumbnail = new QPixmap(size, size);
         QPixmap *tmp;
         tmp = new QPixmap(filePath, "JPG");
-        *tmp = tmp->scaled(size * 2,
-                           size * 2,
+        *tmp = tmp->scaled(size,
+                           size,
                            method,
-                           Qt::FastTransformation)
-               .scaled(size,
-                       size,
-                       method,
-                       Qt::SmoothTransformation);
+                           Qt::SmoothTransformation);
 
         QFile tmpFile(filePath);
         tmpFile.remove();
 
         if(squared) {
-            QRect target(0, 0, size, size);
-            target.moveCenter(tmp->rect().center());
-            QPixmap *thumbnail = new QPixmap(size, size);
-            *thumbnail = tmp->copy(target);
-            delete tmp;
-            return thumbnail;
+            return cropSquare(tmp, size);
         } else {
             return tmp;
         }
@@ -130,6 +122,12 @@ const QImage *Video::getImage() {
     return NULL;
 }
 
+// frames are decoded by the video player from getClip(),
+// there is no still image to share
+QImage Video::sharedImage() {
+    return QImage();
+}
+
 Clip *Video::getClip() {
     return clip;
 }
@@ -146,6 +144,11 @@ QSize Video::size() {
     return isLoaded() ? clip->size() : QSize(0, 0);
 }
 
+// decoding is done by the video player
+qint64 Video::memoryUsage() {
+    return 0;
+}
+
 void Video::rotate(int grad) {
     if (isLoaded()) {
         clip->rotate(grad);
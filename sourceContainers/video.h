@@ -18,15 +18,17 @@ public:
 
     QPixmap* getPixmap();
     const QImage* getImage();
+    QImage sharedImage();
     Clip* getClip();    // getPixmap's video equivalent
     void load();
     void unload();
     int height();
     int width();
     QSize size();
+    qint64 memoryUsage();
 
     void rotate(int grad);
-    QPixmap* generateThumbnail(bool squared);
+    QPixmap* generateThumbnail(int size, bool squared);
 
 public slots:
     void crop(QRect newRect);
@@ -0,0 +1,87 @@
+#include "test_resampler.h"
+
+#include <QtTest>
+#include "../lib/resampler.h"
+
+QTEST_MAIN(Test_Resampler);
+
+void Test_Resampler::initTestCase() {
+    defaultKernel = QString::fromLatin1(Resampler::kernelName());
+    qsrand(1234);
+}
+
+void Test_Resampler::cleanupTestCase() {
+    Resampler::setKernel(defaultKernel);
+}
+
+// every simd kernel against the scalar one, random sizes, both filters
+void Test_Resampler::kernelsMatchScalar_data() {
+    QStringList kernels = Resampler::availableKernels();
+    if(kernels.count() == 1) {
+        QSKIP("only the scalar kernel is available");
+    }
+    QTest::addColumn<QString>("kernel");
+    QTest::addColumn<int>("filter");
+    for(int i = 1; i < kernels.count(); i++) {
+        QString name = kernels.at(i);
+        QTest::newRow(qPrintable(name + " bilinear")) << name << (int)Resampler::FILTER_BILINEAR;
+        QTest::newRow(qPrintable(name + " bicubic")) << name << (int)Resampler::FILTER_BICUBIC;
+    }
+}
+
+void Test_Resampler::kernelsMatchScalar() {
+    QFETCH(QString, kernel);
+    QFETCH(int, filter);
+
+    for(int i = 0; i < 50; i++) {
+        QImage src = randomImage(1 + qrand() % 300, 1 + qrand() % 300);
+        QSize size(1 + qrand() % 400, 1 + qrand() % 400);
+        QImage expected = scale(src, size, filter, "scalar");
+        QImage result = scale(src, size, filter, kernel);
+        QVERIFY2(maxDifference(expected, result) <= 1,
+                 qPrintable(QString("%1x%2 -> %3x%4").arg(src.width()).arg(src.height())
+                                                       .arg(size.width()).arg(size.height())));
+    }
+}
+
+// premultiplied, so color never exceeds alpha
+QImage Test_Resampler::randomImage(int width, int height) {
+    QImage image(width, height, QImage::Format_ARGB32_Premultiplied);
+    for(int y = 0; y < height; y++) {
+        QRgb *line = reinterpret_cast<QRgb*>(image.scanLine(y));
+        for(int x = 0; x < width; x++) {
+            int a = qrand() % 256;
+            line[x] = qRgba(qrand() % (a + 1), qrand() % (a + 1), qrand() % (a + 1), a);
+        }
+    }
+    return image;
+}
+
+QImage Test_Resampler::scale(const QImage &src, QSize size, int filter, QString kernel) {
+    QImage dst(size, QImage::Format_ARGB32_Premultiplied);
+    if(!Resampler::setKernel(kernel)) {
+        return QImage();
+    }
+    Resampler resampler(src.width(), src.height(), size.width(), size.height(),
+                        (Resampler::Filter)filter);
+    resampler.resample(src.constBits(), src.bytesPerLine(),
+                       dst.bits(), dst.bytesPerLine(), 0, size.height());
+    return dst;
+}
+
+int Test_Resampler::maxDifference(const QImage &a, const QImage &b) const {
+    if(a.isNull() || b.isNull() || a.size() != b.size()) {
+        return 256;
+    }
+    int difference = 0;
+    for(int y = 0; y < a.height(); y++) {
+        const uchar *lineA = a.constScanLine(y);
+        const uchar *lineB = b.constScanLine(y);
+        for(int x = 0; x < a.width() * 4; x++) {
+            difference = qMax(difference, qAbs(lineA[x] - lineB[x]));
+        }
+    }
+    return difference;
+}
+
+#include "test_resampler.moc"
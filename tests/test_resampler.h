@@ -0,0 +1,25 @@
+#ifndef TEST_RESAMPLER_H
+#define TEST_RESAMPLER_H
+
+#include <QObject>
+#include <QImage>
+
+class Test_Resampler : public QObject
+{
+    Q_OBJECT
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void kernelsMatchScalar_data();
+    void kernelsMatchScalar();
+private:
+    QImage randomImage(int width, int height);
+    QImage scale(const QImage &src, QSize size, int filter, QString kernel);
+    // largest difference of any channel
+    int maxDifference(const QImage &a, const QImage &b) const;
+
+    QString defaultKernel;
+};
+
+#endif // TEST_RESAMPLER_H
@@ -80,10 +80,17 @@ void ThumbnailLabel::applySettings() {
 }
 
 void ThumbnailLabel::setThumbnail(Thumbnail *_thumbnail) {
-    if(_thumbnail) {
+    if(!_thumbnail) {
+        thumbnail = NULL;
+        loaded = false;
+        showLabel = false;
+        state = EMPTY;
+        this->setPixmap(QPixmap());
+    } else {
         thumbnail = _thumbnail;
         this->setPixmap(*_thumbnail->image);
         loaded = true;
+        state = LOADED;
         showLabel = settings->showThumbnailLabels() && !thumbnail->label.isEmpty();
         updateLabelWidth();
         float widthFactor = fm->width(thumbnail->name) / (float)(thumbnailSize - 13);
@@ -214,7 +221,6 @@ void ThumbnailLabel::leaveEvent(QEvent *event) {
 }
 
 ThumbnailLabel::~ThumbnailLabel() {
-    delete thumbnail;
     delete highlightColor;
     delete outlineColor;
     delete highlightColorBorder;
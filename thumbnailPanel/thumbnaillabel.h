@@ -23,6 +23,7 @@ public:
 
     bool isLoaded();
     loadState state;
+    // not owned; NULL clears the label so it can be reused
     void setThumbnail(Thumbnail *_thumbnail);
 
     void setHighlighted(bool x);
@@ -2,14 +2,15 @@
 
 ThumbnailStrip::ThumbnailStrip(QWidget *parent)
     : QWidget(parent),
+      vertical(false),
+      thumbView(NULL),
       panelSize(122),
       current(-1),
       margin(2),
-      thumbView(NULL),
-      parentFullscreen(false)
+      parentFullscreen(false),
+      resizePending(false)
 {
     parentSz = parent->size();
-    thumbnailLabels = new QList<ThumbnailLabel*>();
 
     thumbView = new ThumbnailView();
     widget = new ClickableWidget();
@@ -17,9 +18,6 @@ ThumbnailStrip::ThumbnailStrip(QWidget *parent)
     thumbView->setWidget(widget);
     thumbView->setFrameShape(QFrame::NoFrame);
 
-    viewLayout = new QBoxLayout(QBoxLayout::LeftToRight);
-    viewLayout->setSpacing(0);
-    widget->setLayout(viewLayout);
     widget->setStyleSheet("background-color: #202020;"); // doesnt work from qss for some reason
 
     scrollBar = thumbView->horizontalScrollBar();
@@ -100,9 +98,17 @@ void ThumbnailStrip::readSettings() {
     scrollBar->setValue(0);
     updatePanelPosition();
 
-    for(int i = 0; i < thumbnailLabels->count(); i++) {
-        thumbnailLabels->at(i)->applySettings();
+    QHash<int, ThumbnailLabel*>::const_iterator it = labels.constBegin();
+    for(; it != labels.constEnd(); ++it) {
+        it.value()->applySettings();
+    }
+    for(int i = 0; i < unusedLabels.count(); i++) {
+        unusedLabels.at(i)->applySettings();
     }
+    // all labels share the same size
+    ThumbnailLabel *probe = takeLabel();
+    itemSize = probe->size();
+    releaseLabel(probe);
 
     disconnect(timeLine, SIGNAL(frameChanged(int)),
                scrollBar, SLOT(setValue(int)));
@@ -116,8 +122,7 @@ void ThumbnailStrip::readSettings() {
         thumbView->setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
         thumbView->setVerticalScrollBarPolicy(Qt::ScrollBarAsNeeded);
         scrollBar = thumbView->verticalScrollBar();
-        viewLayout->setDirection(QBoxLayout::TopToBottom);
-        viewLayout->setContentsMargins(0, margin, 0, margin);
+        vertical = true;
         buttonsLayout->setDirection(QBoxLayout::LeftToRight);
         if(position == LEFT)
             layout->setDirection(QBoxLayout::BottomToTop);
@@ -127,8 +132,7 @@ void ThumbnailStrip::readSettings() {
         thumbView->setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
         thumbView->setHorizontalScrollBarPolicy(Qt::ScrollBarAsNeeded);
         scrollBar = thumbView->horizontalScrollBar();
-        viewLayout->setDirection(QBoxLayout::LeftToRight);
-        viewLayout->setContentsMargins(margin, 0, margin, 0);
+        vertical = false;
         buttonsLayout->setDirection(QBoxLayout::BottomToTop);
         layout->setDirection(QBoxLayout::RightToLeft);
     }
@@ -141,28 +145,20 @@ void ThumbnailStrip::readSettings() {
             this, SLOT(loadVisibleThumbnailsDelayed()), Qt::UniqueConnection);
     connect(timeLine, SIGNAL(frameChanged(int)),
             scrollBar, SLOT(setValue(int)), Qt::UniqueConnection);
-    widget->setFixedSize(viewLayout->sizeHint());
+    updateWidgetSize();
+    loadVisibleThumbnailsDelayed();
 }
 
 void ThumbnailStrip::populate(int count) {
     if(count >= 0 ) {
-        widget->hide();
-        for(int i = thumbnailLabels->count() - 1; i >= 0; --i) {
-            delete viewLayout->takeAt(0);
-            delete thumbnailLabels->takeAt(0);
-        }
-        // remove stretch
-        viewLayout->takeAt(0);
-        //recreate list
-        delete thumbnailLabels;
-        thumbnailLabels = new QList<ThumbnailLabel*>();
-
+        releaseAllLabels();
+        qDeleteAll(thumbnails);
+        thumbnails.clear();
+        requested.clear();
         for(int i = 0; i < count; i++) {
-            addItem();
+            thumbnails.append(NULL);
         }
-        viewLayout->addStretch(1);
-        widget->setFixedSize(viewLayout->sizeHint());
-        widget->show();
+        updateWidgetSize();
     }
 }
 
@@ -175,21 +171,95 @@ void ThumbnailStrip::fillPanel(int count) {
     }
 }
 
-void ThumbnailStrip::addItem() {
-    ThumbnailLabel *thumbLabel = new ThumbnailLabel();
-    thumbLabel->setOpacity(0.0f);
-    thumbnailLabels->append(thumbLabel);
-    viewLayout->addWidget(thumbLabel);
+void ThumbnailStrip::insertItem(int pos) {
+    if(pos < 0 || pos > thumbnails.count()) {
+        return;
+    }
+    thumbnails.insert(pos, NULL);
+    requested.clear();
+    QHash<int, ThumbnailLabel*> shifted;
+    QHash<int, ThumbnailLabel*>::const_iterator it = labels.constBegin();
+    for(; it != labels.constEnd(); ++it) {
+        shifted.insert((it.key() >= pos) ? it.key() + 1 : it.key(), it.value());
+    }
+    labels = shifted;
+    if(current >= pos) {
+        current++;
+    }
+    resizePending = true;
+    loadVisibleThumbnailsDelayed();
+}
+
+void ThumbnailStrip::removeItem(int pos) {
+    if(pos < 0 || pos >= thumbnails.count()) {
+        return;
+    }
+    requested.clear();
+    if(current == pos) {
+        current = -1;
+    } else if(current > pos) {
+        current--;
+    }
+    QHash<int, ThumbnailLabel*> shifted;
+    QHash<int, ThumbnailLabel*>::const_iterator it = labels.constBegin();
+    for(; it != labels.constEnd(); ++it) {
+        if(it.key() == pos) {
+            releaseLabel(it.value());
+        } else {
+            shifted.insert((it.key() > pos) ? it.key() - 1 : it.key(), it.value());
+        }
+    }
+    labels = shifted;
+    delete thumbnails.takeAt(pos);
+    resizePending = true;
+    loadVisibleThumbnailsDelayed();
+}
+
+void ThumbnailStrip::reorderItems(QVector<int> moved, int count) {
+    if(moved.count() != thumbnails.count()) {
+        fillPanel(count);
+        return;
+    }
+    requested.clear();
+    QList<Thumbnail*> reordered;
+    for(int i = 0; i < count; i++) {
+        reordered.append(NULL);
+    }
+    QVector<bool> taken(count, false);
+    QHash<int, ThumbnailLabel*> movedLabels;
+    for(int i = 0; i < moved.count(); i++) {
+        int pos = moved.at(i);
+        ThumbnailLabel *label = labels.value(i, NULL);
+        if(pos >= 0 && pos < count && !taken.at(pos)) {
+            taken[pos] = true;
+            reordered[pos] = thumbnails.at(i);
+            if(label) {
+                movedLabels.insert(pos, label);
+            }
+        } else {
+            delete thumbnails.at(i);
+            if(label) {
+                releaseLabel(label);
+            }
+        }
+    }
+    thumbnails = reordered;
+    labels = movedLabels;
+    current = moved.value(current, -1);
+    resizePending = true;
+    loadVisibleThumbnailsDelayed();
 }
 
 void ThumbnailStrip::selectThumbnail(int pos) {
-    if(current >= 0 && current < thumbnailLabels->count()) {
-        thumbnailLabels->at(current)->setHighlighted(false);
-        thumbnailLabels->at(current)->setOpacityAnimated(OPACITY_INACTIVE, ANIMATION_SPEED_INSTANT);
+    ThumbnailLabel *label = labels.value(current, NULL);
+    if(label) {
+        label->setHighlighted(false);
+        label->setOpacityAnimated(OPACITY_INACTIVE, ANIMATION_SPEED_INSTANT);
     }
-    if(pos >= 0 && pos < thumbnailLabels->count()) {
-        thumbnailLabels->at(pos)->setHighlighted(true);
-        thumbnailLabels->at(pos)->setOpacityAnimated(OPACITY_SELECTED, ANIMATION_SPEED_INSTANT);
+    label = labels.value(pos, NULL);
+    if(label) {
+        label->setHighlighted(true);
+        label->setOpacityAnimated(OPACITY_SELECTED, ANIMATION_SPEED_INSTANT);
     }
     current = pos;
     loadVisibleThumbnails();
@@ -197,8 +267,10 @@ void ThumbnailStrip::selectThumbnail(int pos) {
 }
 
 void ThumbnailStrip::focusOn(int pos) {
-    if(pos >= 0 && pos < thumbnailLabels->count() && !childVisibleEntirely(pos)) {
-        thumbView->ensureWidgetVisible(thumbnailLabels->at(pos), 350, 350);
+    if(pos >= 0 && pos < thumbnails.count() && !childVisibleEntirely(pos)) {
+        QRect rect = itemRect(pos);
+        thumbView->ensureVisible(rect.center().x(), rect.center().y(),
+                                 rect.width() / 2 + 350, rect.height() / 2 + 350);
     }
 }
 
@@ -209,26 +281,64 @@ void ThumbnailStrip::loadVisibleThumbnailsDelayed() {
 
 void ThumbnailStrip::loadVisibleThumbnails() {
     loadTimer.stop();
+    // once for a whole batch of added files
+    if(resizePending) {
+        resizePending = false;
+        updateWidgetSize();
+    }
     updateVisibleRegion();
-    for(int i = 0; i < thumbnailLabels->count(); i++) {
-        requestThumbnail(i);
+    int first, last, visibleFirst, visibleLast;
+    if(!itemRange(preloadArea, first, last)) {
+        releaseAllLabels();
+        requested.clear();
+        emit thumbnailRangeChanged(-1, -1);
+        return;
+    }
+    updateLabels(first, last);
+    // the loader drops requests outside of the range
+    for(QSet<int>::iterator i = requested.begin(); i != requested.end();) {
+        if(*i < first || *i > last) {
+            i = requested.erase(i);
+        } else {
+            ++i;
+        }
+    }
+    emit thumbnailRangeChanged(first, last);
+    // loader serves newest requests first,
+    // so go from the edges of preload area towards the middle of the view
+    int center = itemRange(visibleRegion, visibleFirst, visibleLast) ?
+                     (visibleFirst + visibleLast) / 2 : (first + last) / 2;
+    for(int i = qMax(center - first, last - center); i > 0; i--) {
+        requestThumbnail(center + i);
+        requestThumbnail(center - i);
     }
+    requestThumbnail(center);
 }
 
+// each item is requested once while it stays in range
 void ThumbnailStrip::requestThumbnail(int pos) {
-    if(pos >= 0 && pos < thumbnailLabels->count()) {
-        if(thumbnailLabels->at(pos)->state == EMPTY  && childVisible(pos)) {
-            thumbnailLabels->at(pos)->state = LOADING;
-            emit thumbnailRequested(pos);
-        }
+    if(childVisible(pos) && !thumbnails.at(pos) && !requested.contains(pos)) {
+        requested.insert(pos);
+        emit thumbnailRequested(pos);
     }
 }
 
 void ThumbnailStrip::setThumbnail(int pos, Thumbnail *thumb) {
-    thumbnailLabels->at(pos)->setThumbnail(thumb);
-    thumbnailLabels->at(pos)->state = LOADED;
-    if(pos != current) {
-        thumbnailLabels->at(pos)->setOpacityAnimated(OPACITY_INACTIVE, ANIMATION_SPEED_NORMAL);
+    if(pos < 0 || pos >= thumbnails.count()) {
+        delete thumb;
+        return;
+    }
+    Thumbnail *old = thumbnails.at(pos);
+    thumbnails[pos] = thumb;
+    ThumbnailLabel *label = labels.value(pos, NULL);
+    if(label) {
+        label->setThumbnail(thumb);
+        if(pos != current) {
+            label->setOpacityAnimated(OPACITY_INACTIVE, ANIMATION_SPEED_NORMAL);
+        }
+    }
+    if(old != thumb) {
+        delete old;
     }
 }
 
@@ -238,7 +348,7 @@ void ThumbnailStrip::updateVisibleRegion() {
     layout->invalidate();
     layout->activate();
 
-    if(viewLayout->direction() == QBoxLayout::LeftToRight) {
+    if(!vertical) {
         visibleRegion = thumbView->rect().translated(scrollBar->value(), 0);
         preloadArea = visibleRegion.adjusted(-OFFSCREEN_PRELOAD_AREA, 0, OFFSCREEN_PRELOAD_AREA, 0);
     } else {
@@ -248,8 +358,8 @@ void ThumbnailStrip::updateVisibleRegion() {
 }
 
 bool ThumbnailStrip::childVisible(int pos) {
-    if(pos >= 0 && pos < thumbnailLabels->count() &&
-       preloadArea.intersects(viewLayout->itemAt(pos)->geometry()))
+    if(pos >= 0 && pos < thumbnails.count() &&
+       preloadArea.intersects(itemRect(pos)))
     {
         return true;
     }
@@ -257,15 +367,119 @@ bool ThumbnailStrip::childVisible(int pos) {
 }
 
 bool ThumbnailStrip::childVisibleEntirely(int pos) {
-    if(pos >= 0 && pos < thumbnailLabels->count() &&
-       visibleRegion.contains(viewLayout->itemAt(pos)->geometry().topLeft()) &&
-       visibleRegion.contains(viewLayout->itemAt(pos)->geometry().bottomRight()))
+    if(pos >= 0 && pos < thumbnails.count() &&
+       visibleRegion.contains(itemRect(pos).topLeft()) &&
+       visibleRegion.contains(itemRect(pos).bottomRight()))
     {
         return true;
     }
     return false;
 }
 
+QRect ThumbnailStrip::itemRect(int pos) {
+    if(vertical) {
+        return QRect(0, margin + pos * itemSize.height(),
+                     itemSize.width(), itemSize.height());
+    }
+    return QRect(margin + pos * itemSize.width(), 0,
+                 itemSize.width(), itemSize.height());
+}
+
+int ThumbnailStrip::itemAt(QPoint point) {
+    int extent = vertical ? itemSize.height() : itemSize.width();
+    int offset = (vertical ? point.y() : point.x()) - margin;
+    if(extent <= 0 || offset < 0) {
+        return -1;
+    }
+    int pos = offset / extent;
+    if(pos >= thumbnails.count() || !itemRect(pos).contains(point)) {
+        return -1;
+    }
+    return pos;
+}
+
+bool ThumbnailStrip::itemRange(const QRectF &area, int &first, int &last) {
+    int extent = vertical ? itemSize.height() : itemSize.width();
+    qreal start = (vertical ? area.top() : area.left()) - margin;
+    qreal end = (vertical ? area.bottom() : area.right()) - margin;
+    if(thumbnails.isEmpty() || extent <= 0 || end <= 0) {
+        return false;
+    }
+    first = (int)(qMax<qreal>(start, 0) / extent);
+    last = qMin(thumbnails.count() - 1, (int)(end / extent));
+    return first <= last;
+}
+
+void ThumbnailStrip::updateWidgetSize() {
+    if(vertical) {
+        widget->setFixedSize(itemSize.width(),
+                             margin * 2 + thumbnails.count() * itemSize.height());
+    } else {
+        widget->setFixedSize(margin * 2 + thumbnails.count() * itemSize.width(),
+                             itemSize.height());
+    }
+}
+
+void ThumbnailStrip::updateLabels(int first, int last) {
+    QHash<int, ThumbnailLabel*>::iterator it = labels.begin();
+    while(it != labels.end()) {
+        if(it.key() < first || it.key() > last) {
+            releaseLabel(it.value());
+            it = labels.erase(it);
+        } else {
+            // position may have changed after insert / remove
+            it.value()->setGeometry(itemRect(it.key()));
+            ++it;
+        }
+    }
+    for(int i = first; i <= last; i++) {
+        if(!labels.contains(i)) {
+            ThumbnailLabel *label = takeLabel();
+            labels.insert(i, label);
+            setupLabel(label, i);
+        }
+    }
+}
+
+void ThumbnailStrip::setupLabel(ThumbnailLabel *label, int pos) {
+    label->setGeometry(itemRect(pos));
+    label->setThumbnail(thumbnails.at(pos));
+    label->setHighlighted(pos == current);
+    if(pos == current) {
+        label->setOpacity(OPACITY_SELECTED);
+    } else if(thumbnails.at(pos)) {
+        label->setOpacity(OPACITY_INACTIVE);
+    } else {
+        label->setOpacity(0.0f);
+    }
+    label->show();
+}
+
+ThumbnailLabel* ThumbnailStrip::takeLabel() {
+    if(unusedLabels.isEmpty()) {
+        ThumbnailLabel *label = new ThumbnailLabel(widget);
+        label->hide();
+        return label;
+    }
+    return unusedLabels.takeLast();
+}
+
+// does not remove the label from labels
+void ThumbnailStrip::releaseLabel(ThumbnailLabel *label) {
+    label->hide();
+    label->setThumbnail(NULL);
+    label->setHighlighted(false);
+    unusedLabels.append(label);
+}
+
+void ThumbnailStrip::releaseAllLabels() {
+    QHash<int, ThumbnailLabel*>::const_iterator it = labels.constBegin();
+    for(; it != labels.constEnd(); ++it) {
+        releaseLabel(it.value());
+    }
+    labels.clear();
+}
+
 // shows/hides exit button on the panel
 void ThumbnailStrip::enableWindowControls(bool enabled) {
     if(enabled && (position == RIGHT || position == TOP))
@@ -276,13 +490,7 @@ void ThumbnailStrip::enableWindowControls(bool enabled) {
 }
 
 void ThumbnailStrip::viewPressed(QPoint pos) {
-    int itemPos = -1;
-    // todo: quick search
-    for (int i=0; i<viewLayout->count(); i++) {
-        if(viewLayout->itemAt(i)->geometry().contains(pos)) {
-            itemPos = i;
-        }
-    }
+    int itemPos = itemAt(pos);
     if(itemPos != -1) {
         selectThumbnail(itemPos);
         emit thumbnailClicked(itemPos);
@@ -340,4 +548,5 @@ void ThumbnailStrip::leaveEvent(QEvent *event) {
 }
 
 ThumbnailStrip::~ThumbnailStrip() {
+    qDeleteAll(thumbnails);
 }
@@ -10,6 +10,9 @@
 #include <QTimer>
 #include <QTimeLine>
 #include <QPropertyAnimation>
+#include <QVector>
+#include <QHash>
+#include <QSet>
 #include "../customWidgets/clickablelabel.h"
 #include "../customWidgets/clickablewidget.h"
 #include "../sourceContainers/thumbnail.h"
@@ -26,9 +29,19 @@ public:
 
     void updatePanelPosition();
 private:
-    QList<ThumbnailLabel*> *thumbnailLabels;
-    void addItem();
-    QBoxLayout *layout, *buttonsLayout, *viewLayout;
+    // One entry per file, NULL until loaded. Owned.
+    // Only items near the visible area get a label; labels of items
+    // that scroll away go back to the pool and are reused
+    QList<Thumbnail*> thumbnails;
+    QHash<int, ThumbnailLabel*> labels;
+    QList<ThumbnailLabel*> unusedLabels;
+    // asked from the loader, no thumbnail yet.
+    // Cleared when items move, the loader ignores repeated requests
+    QSet<int> requested;
+    // items are laid out in a row (or column) of this size each
+    QSize itemSize;
+    bool vertical;
+    QBoxLayout *layout, *buttonsLayout;
     QWidget *buttonsWidget;
     ClickableLabel *openButton, *saveButton, *settingsButton, *exitButton;
     ClickableWidget *widget;
@@ -58,11 +71,27 @@ private:
     PanelPosition position;
     QSize parentSz;
     bool parentFullscreen;
+    // items were added or removed since the last layout update
+    bool resizePending;
 
     void requestThumbnail(int pos);
     void focusOn(int pos);
+    QRect itemRect(int pos);
+    // item under a point of the view widget, -1 if none
+    int itemAt(QPoint point);
+    // items intersecting area; false if there are none
+    bool itemRange(const QRectF &area, int &first, int &last);
+    void updateWidgetSize();
+    // gives labels to items in [first, last] and takes them from the rest
+    void updateLabels(int first, int last);
+    void setupLabel(ThumbnailLabel *label, int pos);
+    ThumbnailLabel* takeLabel();
+    void releaseLabel(ThumbnailLabel *label);
+    void releaseAllLabels();
 signals:
     void thumbnailRequested(int pos);
+    // labels within preload area, -1 if none
+    void thumbnailRangeChanged(int first, int last);
     void thumbnailClicked(int pos);
     void openClicked();
     void saveClicked();
@@ -77,6 +106,12 @@ public slots:
     void loadVisibleThumbnailsDelayed();
     void setThumbnail(int, Thumbnail*);
     void fillPanel(int);
+    // single file added to / removed from the directory
+    void insertItem(int pos);
+    void removeItem(int pos);
+    // same files in a new order; moved[old position] = new position or -1.
+    // Labels move with their files, loaded thumbnails are kept
+    void reorderItems(QVector<int> moved, int count);
     void selectThumbnail(int pos);
     void enableWindowControls(bool);
 
@@ -0,0 +1,89 @@
+#include "thumbnailcache.h"
+
+ThumbnailCache::ThumbnailCache() {
+    baseDir = QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation) + "/thumbnails/";
+}
+
+QString ThumbnailCache::sizeDir(int storedSize) {
+    switch(storedSize) {
+    case 128:
+        return "normal";
+    case 256:
+        return "large";
+    case 512:
+        return "x-large";
+    default:
+        return "xx-large";
+    }
+}
+
+QString ThumbnailCache::uriFor(QString path) {
+    return QString::fromLatin1(QUrl::fromLocalFile(QFileInfo(path).absoluteFilePath()).toEncoded());
+}
+
+QString ThumbnailCache::thumbnailPath(QString uri, int storedSize) {
+    QByteArray hash = QCryptographicHash::hash(uri.toUtf8(), QCryptographicHash::Md5).toHex();
+    return baseDir + sizeDir(storedSize) + "/" + QString::fromLatin1(hash) + ".png";
+}
+
+QImage ThumbnailCache::get(QString path, int size, QString &label) {
+    QFileInfo file(path);
+    QString uri = uriFor(path);
+    QImageReader reader(thumbnailPath(uri, storedSize(size)), "png");
+    // text chunks come before image data, so stale entries are rejected cheaply
+    if(!reader.canRead() ||
+       reader.text("Thumb::URI") != uri ||
+       reader.text("Thumb::MTime") != QString::number(file.lastModified().toTime_t()))
+    {
+        return QImage();
+    }
+    QString fileSize = reader.text("Thumb::Size");
+    if(!fileSize.isEmpty() && fileSize != QString::number(file.size())) {
+        return QImage();
+    }
+    label = reader.text("X-qimgv::Label");
+    return reader.read();
+}
+
+// written to a temporary file first, then renamed into place
+void ThumbnailCache::put(QString path, int size, QImage thumbnail, QString label) {
+    if(thumbnail.isNull()) {
+        return;
+    }
+    QFileInfo file(path);
+    // do not thumbnail the thumbnails
+    if(file.absoluteFilePath().startsWith(baseDir)) {
+        return;
+    }
+    int stored = storedSize(size);
+    QString dirPath = baseDir + sizeDir(stored);
+    if(!QDir().mkpath(dirPath)) {
+        return;
+    }
+    QFile::setPermissions(dirPath, QFile::ReadOwner | QFile::WriteOwner | QFile::ExeOwner);
+
+    QString uri = uriFor(path);
+    thumbnail.setText("Thumb::URI", uri);
+    thumbnail.setText("Thumb::MTime", QString::number(file.lastModified().toTime_t()));
+    thumbnail.setText("Thumb::Size", QString::number(file.size()));
+    thumbnail.setText("Software", "qimgv");
+    if(!label.isEmpty()) {
+        thumbnail.setText("X-qimgv::Label", label);
+    }
+
+    QTemporaryFile tmp(dirPath + "/qimgv-XXXXXX.png");
+    if(!tmp.open()) {
+        return;
+    }
+    tmp.setPermissions(QFile::ReadOwner | QFile::WriteOwner);
+    QImageWriter writer(&tmp, "png");
+    if(!writer.write(thumbnail)) {
+        return;
+    }
+    tmp.close();
+    QString target = thumbnailPath(uri, stored);
+    QFile::remove(target);
+    if(tmp.rename(target)) {
+        tmp.setAutoRemove(false);
+    }
+}
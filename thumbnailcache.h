@@ -0,0 +1,38 @@
+#ifndef THUMBNAILCACHE_H
+#define THUMBNAILCACHE_H
+
+#include <QString>
+#include <QImage>
+#include <QImageReader>
+#include <QImageWriter>
+#include <QFileInfo>
+#include <QDir>
+#include <QUrl>
+#include <QDateTime>
+#include <QTemporaryFile>
+#include <QStandardPaths>
+#include <QCryptographicHash>
+#include "thumbnailstore.h"
+
+// Persistent thumbnail storage using the freedesktop.org layout
+// (~/.cache/thumbnails/{normal,large,x-large,xx-large}/<md5 of uri>.png),
+// so thumbnails are shared with file managers.
+// Entries are checked against file mtime and size before use.
+// Stateless apart from the base path, safe to use from several threads.
+class ThumbnailCache : public ThumbnailStore
+{
+public:
+    ThumbnailCache();
+
+    QImage get(QString path, int size, QString &label);
+    void put(QString path, int size, QImage thumbnail, QString label);
+
+private:
+    QString baseDir;
+
+    QString uriFor(QString path);
+    QString thumbnailPath(QString uri, int storedSize);
+    QString sizeDir(int storedSize);
+};
+
+#endif // THUMBNAILCACHE_H
@@ -1,45 +1,108 @@
 #include "thumbnailer.h"
 
-Thumbnailer::Thumbnailer(ImageCache *_cache, QString _path, int _target, bool _squared) :
+Thumbnailer::Thumbnailer(ImageCache *_cache, LoadQueue *_queue, ThumbnailStore *_thumbnailStore, QString _path, FileFormat _format, int _target, bool _squared, QSharedPointer<QAtomicInt> _cancelled) :
     path(_path),
+    format(_format),
     target(_target),
+    squared(_squared),
+    cancelled(_cancelled),
     cache(_cache),
-    squared(_squared)
+    queue(_queue),
+    thumbnailStore(_thumbnailStore)
 {
     factory = new ImageFactory();
 }
 
 void Thumbnailer::run() {
-    Image *tempImage;
     Thumbnail *th = new Thumbnail();
-    bool cached = false;
-    if(cache->isLoaded(target)) {
-        tempImage = cache->imageAt(target);
-        //tempImage->lock();
-        cached = true;
-    } else {
-        tempImage = factory->createImage(path);
+    th->name = QFileInfo(path).fileName();
+    int size = settings->thumbnailSize();
+    QImage source;
+    if(!isCancelled()) {
+        source = thumbnailStore->get(path, size, th->label);
+        if(source.isNull() && !isCancelled()) {
+            source = generate(size, th->label);
+        }
     }
-
-    th->image = tempImage->generateThumbnail(squared);
-    if(tempImage->type() == ANIMATED) {
-        th->label = "[" + QString::fromLatin1(tempImage->fileInfo->fileExtension()) + "]";
-    } else if(tempImage->type() == VIDEO) {
-        th->label = "[webm]";
+    // reported without image
+    if(source.isNull() && isCancelled()) {
+        emit thumbnailReady(target, th);
+        return;
+    }
+    th->image = new QPixmap();
+    if(!source.isNull()) {
+        *th->image = QPixmap::fromImage(fit(source, size));
     }
     if(th->image->size() == QSize(0, 0)) {
         delete th->image;
-        th->image = new QPixmap(settings->thumbnailSize(), settings->thumbnailSize());
+        th->image = new QPixmap(size, size);
         th->image->fill(QColor(0,0,0,0));
     }
-    th->name = tempImage->info()->fileName();
+    emit thumbnailReady(target, th);
+}
 
-    if(cached) {
-       // tempImage->unlock();
-    } else {
-        delete tempImage;
+QImage Thumbnailer::generate(int size, QString &label) {
+    // pinned: the loader may unload it from cache while we are working.
+    // By path: files may be added or moved since the request was made
+    QSharedPointer<Image> tempImage = cache->imageFor(path);
+    if(!tempImage) {
+        // let current image and preloads decode first
+        queue->waitForHigherPriority(PRIORITY_THUMBNAIL, LOAD_WAIT_TIMEOUT);
+        if(isCancelled()) {
+            return QImage();
+        }
+        // left unloaded: generateThumbnail() then decodes at thumbnail size
+        tempImage = QSharedPointer<Image>(factory->createUnloaded(path, format));
     }
-    emit thumbnailReady(target, th);
+
+    QPixmap *pixmap = tempImage->generateThumbnail(thumbnailStore->storedSize(size), false);
+    QImage thumbnail = pixmap->toImage();
+    delete pixmap;
+    if(tempImage->type() == ANIMATED) {
+        label = "[" + QString::fromLatin1(tempImage->fileInfo->fileExtension()) + "]";
+    } else if(tempImage->type() == VIDEO) {
+        label = "[webm]";
+    }
+    // video thumbnails may be placeholders when ffmpeg is missing
+    if(tempImage->type() != VIDEO) {
+        thumbnailStore->put(path, size, thumbnail, label);
+    }
+    return thumbnail;
+}
+
+// the crop is not copied, the resampler reads the square from the source
+QImage Thumbnailer::fit(const QImage &source, int size) {
+    QRect area = source.rect();
+    if(squared) {
+        int side = qMin(source.width(), source.height());
+        area.setSize(QSize(side, side));
+        area.moveCenter(source.rect().center());
+    }
+    QSize target = area.size().scaled(size, size, Qt::KeepAspectRatio);
+    if(target.isEmpty()) {
+        return QImage();
+    }
+    if(target == area.size()) {
+        return (area == source.rect()) ? source : source.copy(area);
+    }
+    QImage input = source;
+    if(input.format() != QImage::Format_RGB32 &&
+       input.format() != QImage::Format_ARGB32_Premultiplied)
+    {
+        input = input.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    }
+    QImage thumbnail(target, input.format());
+    Resampler resampler(area.width(), area.height(),
+                        target.width(), target.height(), Resampler::FILTER_BICUBIC);
+    const uchar *src = input.constBits() + area.top() * input.bytesPerLine() + area.left() * 4;
+    resampler.resample(src, input.bytesPerLine(),
+                       thumbnail.bits(), thumbnail.bytesPerLine(),
+                       0, target.height());
+    return thumbnail;
+}
+
+bool Thumbnailer::isCancelled() {
+    return cancelled->load() != 0;
 }
 
 Thumbnailer::~Thumbnailer() {
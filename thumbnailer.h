@@ -5,22 +5,43 @@
 #include <QThread>
 #include <sourceContainers/thumbnail.h>
 #include "imagecache.h"
+#include "loadqueue.h"
+#include "thumbnailstore.h"
 #include <imagefactory.h>
+#include "lib/resampler.h"
 
 class Thumbnailer : public QObject, public QRunnable
 {
     Q_OBJECT
 public:
-    Thumbnailer(ImageCache* _cache, QString _path, int _target, bool _squared);
+    Thumbnailer(ImageCache* _cache, LoadQueue *_queue, ThumbnailStore *_thumbnailStore, QString _path, FileFormat _format, int _target, bool _squared, QSharedPointer<QAtomicInt> _cancelled);
     ~Thumbnailer();
 
     void run();
     QString path;
+    // null if not sniffed yet
+    FileFormat format;
     int target;
     bool squared;
+    // set once the item leaves the thumbnail range.
+    // Checked before reading and before decoding
+    QSharedPointer<QAtomicInt> cancelled;
 private:
     ImageCache* cache;
+    LoadQueue *queue;
+    ThumbnailStore *thumbnailStore;
     ImageFactory *factory;
+
+    bool isCancelled();
+
+    // unsquared thumbnail from the image itself, also stored on disk
+    QImage generate(int size, QString &label);
+    // scales a stored thumbnail to display size in one resample;
+    // squared ones are cropped first
+    QImage fit(const QImage &source, int size);
+
+    // how long thumbnail decoding yields to image loading (ms)
+    const int LOAD_WAIT_TIMEOUT = 500;
 signals:
     void thumbnailReady(int, Thumbnail*);
 };
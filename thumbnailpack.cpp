@@ -0,0 +1,324 @@
+#include "thumbnailpack.h"
+
+ThumbnailPack::ThumbnailPack() :
+    useCount(0)
+{
+    packDir = QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation) + "/qimgv/thumbnails/";
+}
+
+ThumbnailPack::~ThumbnailPack() {
+    flush();
+    QHash<QString, Pack*>::iterator i;
+    for(i = packs.begin(); i != packs.end(); ++i) {
+        unload(i.value());
+        delete i.value();
+    }
+}
+
+QImage ThumbnailPack::get(QString path, int size, QString &label) {
+    QFileInfo info(path);
+    QString name = info.fileName();
+    QMutexLocker locker(&mutex);
+    Pack *pack = select(info.absolutePath(), storedSize(size));
+    if(!pack->entries.contains(name)) {
+        return QImage();
+    }
+    PackEntry entry = pack->entries.value(name);
+    if(entry.mtime != info.lastModified().toTime_t() || entry.fileSize != info.size()) {
+        return QImage();
+    }
+    QByteArray blob;
+    if(pack->pending.contains(name)) {
+        blob = pack->pending.value(name);
+    } else if(pack->data) {
+        // copy, the mapping may go away once the lock is released
+        blob = QByteArray(reinterpret_cast<const char*>(pack->data + entry.offset), entry.length);
+    }
+    locker.unlock();
+    label = entry.label;
+    return decode(entry, blob);
+}
+
+void ThumbnailPack::put(QString path, int size, QImage thumbnail, QString label) {
+    if(thumbnail.isNull()) {
+        return;
+    }
+    QFileInfo info(path);
+    PackEntry entry;
+    QByteArray blob;
+    if(thumbnail.hasAlphaChannel()) {
+        QImage argb = thumbnail.convertToFormat(QImage::Format_ARGB32);
+        blob = QByteArray(reinterpret_cast<const char*>(argb.constBits()), argb.byteCount());
+        entry.format = BLOB_ARGB32;
+    } else {
+        QBuffer buffer(&blob);
+        buffer.open(QIODevice::WriteOnly);
+        thumbnail.save(&buffer, "JPEG", JPEG_QUALITY);
+        entry.format = BLOB_JPEG;
+    }
+    entry.mtime = info.lastModified().toTime_t();
+    entry.fileSize = info.size();
+    entry.offset = 0;
+    entry.length = blob.size();
+    entry.width = thumbnail.width();
+    entry.height = thumbnail.height();
+    entry.label = label;
+
+    QString name = info.fileName();
+    QMutexLocker locker(&mutex);
+    Pack *pack = select(info.absolutePath(), storedSize(size));
+    if(pack->entries.contains(name) && !pack->pending.contains(name)) {
+        pack->staleBytes += pack->entries.value(name).length;
+    }
+    pack->entries.insert(name, entry);
+    pack->pending.insert(name, blob);
+    if(pack->pending.count() >= FLUSH_THRESHOLD) {
+        flushPending(pack);
+    }
+}
+
+void ThumbnailPack::flush() {
+    QMutexLocker locker(&mutex);
+    QHash<QString, Pack*>::iterator i;
+    for(i = packs.begin(); i != packs.end(); ++i) {
+        flushPending(i.value());
+    }
+}
+
+QImage ThumbnailPack::decode(const PackEntry &entry, const QByteArray &blob) {
+    if(blob.size() != (int)entry.length) {
+        return QImage();
+    }
+    if(entry.format == BLOB_ARGB32) {
+        if(blob.size() != entry.width * entry.height * 4) {
+            return QImage();
+        }
+        return QImage(reinterpret_cast<const uchar*>(blob.constData()),
+                      entry.width, entry.height, entry.width * 4,
+                      QImage::Format_ARGB32).copy();
+    }
+    return QImage::fromData(blob, "JPEG");
+}
+
+// ##############################################################
+// ####################### PRIVATE METHODS ######################
+// ##############################################################
+
+// pack for given directory and thumbnail size.
+// The least recently used one is closed once too many are open
+ThumbnailPack::Pack *ThumbnailPack::select(QString dir, int storedSize) {
+    QByteArray hash = QCryptographicHash::hash(dir.toUtf8(), QCryptographicHash::Md5).toHex();
+    QString path = packDir + QString::fromLatin1(hash) + "-" + QString::number(storedSize);
+    Pack *pack = packs.value(path, NULL);
+    if(!pack) {
+        if(packs.count() >= MAX_OPEN_PACKS) {
+            Pack *oldest = NULL;
+            QHash<QString, Pack*>::iterator i;
+            for(i = packs.begin(); i != packs.end(); ++i) {
+                if(!oldest || i.value()->lastUse < oldest->lastUse) {
+                    oldest = i.value();
+                }
+            }
+            flushPending(oldest);
+            unload(oldest);
+            packs.remove(oldest->path);
+            delete oldest;
+        }
+        pack = new Pack();
+        pack->path = path;
+        load(pack);
+        packs.insert(path, pack);
+    }
+    pack->lastUse = ++useCount;
+    return pack;
+}
+
+// a missing or broken pack reads as empty
+void ThumbnailPack::load(Pack *pack) {
+    pack->entries.clear();
+    pack->id = 0;
+    pack->dataSize = 0;
+    pack->staleBytes = 0;
+    QFile indexFile(pack->path + ".index");
+    if(!indexFile.open(QIODevice::ReadOnly)) {
+        return;
+    }
+    QDataStream index(&indexFile);
+    quint32 magic, count;
+    quint64 id, dataSize, staleBytes;
+    index >> magic >> id >> dataSize >> staleBytes >> count;
+    if(index.status() != QDataStream::Ok || magic != INDEX_MAGIC || dataSize < (quint64)HEADER_SIZE) {
+        return;
+    }
+    QHash<QString, PackEntry> entries;
+    for(quint32 i = 0; i < count && index.status() == QDataStream::Ok; i++) {
+        QString name;
+        PackEntry entry;
+        index >> name >> entry.mtime >> entry.fileSize >> entry.offset >> entry.length
+              >> entry.format >> entry.width >> entry.height >> entry.label;
+        if(entry.offset < (quint64)HEADER_SIZE || entry.offset + entry.length > dataSize) {
+            return;
+        }
+        entries.insert(name, entry);
+    }
+    if(index.status() != QDataStream::Ok) {
+        return;
+    }
+    // only the part the index knows about; an interrupted append may follow
+    pack->file.setFileName(pack->path + ".pack");
+    if(!pack->file.open(QIODevice::ReadOnly) || pack->file.size() < (qint64)dataSize ||
+       (pack->data = pack->file.map(0, dataSize)) == NULL)
+    {
+        unload(pack);
+        return;
+    }
+    QDataStream header(QByteArray::fromRawData(reinterpret_cast<const char*>(pack->data), HEADER_SIZE));
+    quint32 packMagic, reserved;
+    quint64 packId;
+    header >> packMagic >> reserved >> packId;
+    // the pack was rewritten, but its index was not
+    if(packMagic != PACK_MAGIC || packId != id) {
+        unload(pack);
+        return;
+    }
+    pack->entries = entries;
+    pack->id = id;
+    pack->dataSize = dataSize;
+    pack->staleBytes = staleBytes;
+}
+
+void ThumbnailPack::unload(Pack *pack) {
+    if(pack->data) {
+        pack->file.unmap(pack->data);
+        pack->data = NULL;
+    }
+    pack->file.close();
+}
+
+// Another instance may have written the pack since it was loaded,
+// so the index is read again under the lock and pending entries are
+// added to it. On failure they are dropped
+void ThumbnailPack::flushPending(Pack *pack) {
+    if(pack->pending.isEmpty()) {
+        return;
+    }
+    QDir().mkpath(packDir);
+    QLockFile lock(pack->path + ".lock");
+    if(!lock.tryLock(LOCK_TIMEOUT)) {
+        return;
+    }
+    QHash<QString, PackEntry> added;
+    QHash<QString, QByteArray>::const_iterator i;
+    for(i = pack->pending.constBegin(); i != pack->pending.constEnd(); ++i) {
+        added.insert(i.key(), pack->entries.value(i.key()));
+    }
+    unload(pack);
+    load(pack);
+    QHash<QString, PackEntry>::const_iterator j;
+    for(j = added.constBegin(); j != added.constEnd(); ++j) {
+        if(pack->entries.contains(j.key())) {
+            pack->staleBytes += pack->entries.value(j.key()).length;
+        }
+        pack->entries.insert(j.key(), j.value());
+    }
+    if(!pack->data || pack->staleBytes > pack->dataSize / 2) {
+        rewrite(pack);
+    } else {
+        append(pack);
+    }
+    pack->pending.clear();
+    unload(pack);
+    load(pack);
+}
+
+// New blobs go after the known data, then the index is replaced.
+// Whatever an interrupted append left there is overwritten
+bool ThumbnailPack::append(Pack *pack) {
+    unload(pack);
+    QFile file(pack->path + ".pack");
+    if(!file.open(QIODevice::ReadWrite) || !file.seek(pack->dataSize)) {
+        return false;
+    }
+    quint64 offset = pack->dataSize;
+    QHash<QString, QByteArray>::const_iterator i;
+    for(i = pack->pending.constBegin(); i != pack->pending.constEnd(); ++i) {
+        if(file.write(i.value()) != i.value().size()) {
+            return false;
+        }
+        pack->entries[i.key()].offset = offset;
+        offset += i.value().size();
+    }
+    file.resize(offset);
+    file.close();
+    pack->dataSize = offset;
+    return writeIndex(pack);
+}
+
+// writes live blobs into a temporary file which then replaces the pack
+bool ThumbnailPack::rewrite(Pack *pack) {
+    QTemporaryFile tmp(pack->path + "-XXXXXX.tmp");
+    if(!tmp.open()) {
+        return false;
+    }
+    quint64 id = (quint64)QDateTime::currentMSecsSinceEpoch() ^ ((quint64)qrand() << 40);
+    if(id == pack->id) {
+        id++;
+    }
+    QDataStream header(&tmp);
+    header << PACK_MAGIC << (quint32)0 << id;
+    quint64 offset = HEADER_SIZE;
+    QHash<QString, PackEntry>::iterator i;
+    for(i = pack->entries.begin(); i != pack->entries.end(); ++i) {
+        QByteArray blob;
+        if(pack->pending.contains(i.key())) {
+            blob = pack->pending.value(i.key());
+        } else if(pack->data) {
+            blob = QByteArray::fromRawData(reinterpret_cast<const char*>(pack->data + i.value().offset),
+                                           i.value().length);
+        }
+        if(tmp.write(blob) != blob.size()) {
+            return false;
+        }
+        i.value().offset = offset;
+        i.value().length = blob.size();
+        offset += blob.size();
+    }
+    tmp.close();
+    unload(pack);
+    QFile::remove(pack->path + ".pack");
+    if(!tmp.rename(pack->path + ".pack")) {
+        return false;
+    }
+    tmp.setAutoRemove(false);
+    pack->id = id;
+    pack->dataSize = offset;
+    pack->staleBytes = 0;
+    return writeIndex(pack);
+}
+
+// written to a temporary file first, then renamed into place
+bool ThumbnailPack::writeIndex(Pack *pack) {
+    QTemporaryFile tmp(pack->path + ".index-XXXXXX");
+    if(!tmp.open()) {
+        return false;
+    }
+    QDataStream out(&tmp);
+    out << INDEX_MAGIC << pack->id << pack->dataSize << pack->staleBytes
+        << (quint32)pack->entries.count();
+    QHash<QString, PackEntry>::const_iterator i;
+    for(i = pack->entries.constBegin(); i != pack->entries.constEnd(); ++i) {
+        const PackEntry &entry = i.value();
+        out << i.key() << entry.mtime << entry.fileSize << entry.offset << entry.length
+            << entry.format << entry.width << entry.height << entry.label;
+    }
+    if(out.status() != QDataStream::Ok) {
+        return false;
+    }
+    tmp.close();
+    QFile::remove(pack->path + ".index");
+    if(!tmp.rename(pack->path + ".index")) {
+        return false;
+    }
+    tmp.setAutoRemove(false);
+    return true;
+}
@@ -0,0 +1,97 @@
+#ifndef THUMBNAILPACK_H
+#define THUMBNAILPACK_H
+
+#include <QMutex>
+#include <QFile>
+#include <QHash>
+#include <QBuffer>
+#include <QDataStream>
+#include <QDir>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QTemporaryFile>
+#include <QLockFile>
+#include <QStandardPaths>
+#include <QCryptographicHash>
+#include "thumbnailstore.h"
+
+// All thumbnails of one directory in a single file,
+// ~/.cache/qimgv/thumbnails/<md5 of directory>-<size>.pack
+//   [header][blob][blob]...
+// and its index next to it in <...>.index.
+// Blobs are jpeg, or raw ARGB32 for images with alpha.
+// The pack is memory mapped, so reading a thumbnail costs no syscalls.
+// New thumbnails are collected in memory and appended in batches.
+// The index is written to a temporary file and renamed into place, so a
+// crash mid-write leaves the previous index. The pack is rewritten the
+// same way once too much of it is stale; the header id must match the
+// index. Writes from several qimgv instances are serialized by a lock file.
+class ThumbnailPack : public ThumbnailStore
+{
+public:
+    ThumbnailPack();
+    ~ThumbnailPack();
+
+    QImage get(QString path, int size, QString &label);
+    void put(QString path, int size, QImage thumbnail, QString label);
+    void flush();
+
+private:
+    enum BlobFormat { BLOB_JPEG, BLOB_ARGB32 };
+
+    struct PackEntry {
+        qint64 mtime, fileSize;
+        quint64 offset;
+        quint32 length;
+        quint8 format;
+        quint16 width, height;
+        QString label;
+    };
+
+    // one directory at one thumbnail size
+    struct Pack {
+        Pack() : data(NULL), id(0), dataSize(0), staleBytes(0), lastUse(0) {
+        }
+        // without extension
+        QString path;
+        QFile file;
+        uchar *data;
+        quint64 id;
+        // end of the blob data the index knows about
+        quint64 dataSize;
+        // bytes taken by replaced thumbnails
+        quint64 staleBytes;
+        quint64 lastUse;
+        // by file name
+        QHash<QString, PackEntry> entries;
+        // blobs not written to disk yet; their metadata is in entries
+        QHash<QString, QByteArray> pending;
+    };
+
+    QMutex mutex;
+    QString packDir;
+    // open packs by path, kept mapped while switching directories
+    QHash<QString, Pack*> packs;
+    quint64 useCount;
+
+    Pack *select(QString dir, int storedSize);
+    // maps the pack and reads its index
+    void load(Pack *pack);
+    void unload(Pack *pack);
+    void flushPending(Pack *pack);
+    bool append(Pack *pack);
+    bool rewrite(Pack *pack);
+    bool writeIndex(Pack *pack);
+    QImage decode(const PackEntry &entry, const QByteArray &blob);
+
+    const quint32 PACK_MAGIC = 0x51545032;
+    const quint32 INDEX_MAGIC = 0x51544932;
+    const int HEADER_SIZE = 16;
+    const int FLUSH_THRESHOLD = 64;
+    const int JPEG_QUALITY = 90;
+    const int MAX_OPEN_PACKS = 8;
+    // another instance is writing the same pack (ms)
+    const int LOCK_TIMEOUT = 2000;
+};
+
+#endif // THUMBNAILPACK_H
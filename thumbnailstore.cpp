@@ -0,0 +1,22 @@
+#include "thumbnailstore.h"
+
+ThumbnailStore::ThumbnailStore() {
+}
+
+ThumbnailStore::~ThumbnailStore() {
+}
+
+void ThumbnailStore::flush() {
+}
+
+// freedesktop.org size buckets
+int ThumbnailStore::storedSize(int size) {
+    if(size <= 128) {
+        return 128;
+    } else if(size <= 256) {
+        return 256;
+    } else if(size <= 512) {
+        return 512;
+    }
+    return 1024;
+}
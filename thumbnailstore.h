@@ -0,0 +1,26 @@
+#ifndef THUMBNAILSTORE_H
+#define THUMBNAILSTORE_H
+
+#include <QString>
+#include <QImage>
+
+// persistent thumbnail storage used by Thumbnailer.
+// Implementations must be safe to use from several threads.
+class ThumbnailStore
+{
+public:
+    ThumbnailStore();
+    virtual ~ThumbnailStore();
+
+    // stored thumbnail for path that is at least size px, null if missing or stale
+    virtual QImage get(QString path, int size, QString &label) = 0;
+    // thumbnail should be unsquared and storedSize(size) px large
+    virtual void put(QString path, int size, QImage thumbnail, QString label) = 0;
+    // writes out anything kept in memory
+    virtual void flush();
+
+    // size of the stored thumbnail used for the given display size
+    int storedSize(int size);
+};
+
+#endif // THUMBNAILSTORE_H
@@ -4,15 +4,16 @@ ImageViewer::ImageViewer(QWidget *parent) : QWidget(parent),
     isDisplayingFlag(false),
     errorFlag(false),
     mouseWrapping(false),
+    tilingAvailable(false),
+    sourcePending(false),
     currentScale(1.0),
     maxScale(2.0),
     minScale(4.0),
     scaleStep(0.16),
     imageFitMode(NORMAL) {
     initOverlays();
-    image = new QPixmap();
-    image->load(":/images/res/logo.png");
-    drawingRect = image->rect();
+    image.load(":/images/res/logo.png");
+    drawingRect = image.rect();
     this->setMouseTracking(true);
     resizeTimer = new QTimer(this);
     resizeTimer->setSingleShot(true);
@@ -27,6 +28,8 @@ ImageViewer::ImageViewer(QWidget *parent) : QWidget(parent),
             this, SLOT(hideCursor()),
             Qt::UniqueConnection);
     desktopSize = QApplication::desktop()->size();
+    tiles = new TileCache(this);
+    connect(tiles, SIGNAL(tilesReady()), this, SLOT(update()));
 }
 
 ImageViewer::~ImageViewer() {
@@ -50,15 +53,17 @@ bool ImageViewer::imageIsScaled() const {
 }
 
 // display & initialize
-void ImageViewer::displayImage(QPixmap *_image) {
-    delete image;
+void ImageViewer::displayImage(QImage _image, QSize realSize) {
     resizeTimer->stop();
-    sourceSize  = _image->size();
-    drawingRect =  _image->rect();
+    sourceSize  = realSize.isValid() ? realSize : _image.size();
+    drawingRect = QRect(QPoint(0, 0), sourceSize);
 
     errorFlag = false;
     isDisplayingFlag = true;
-    image = _image;
+    image = drawable(_image);
+    tiles->clear();
+    tilingAvailable = true;
+    sourcePending = false;
 
     mapOverlay->setEnabled(true);
 
@@ -87,12 +92,41 @@ void ImageViewer::displayImage(QPixmap *_image) {
 }
 
 // takes scaled image
-void ImageViewer::updateImage(QPixmap *scaled) {
-    delete image;
-    image = scaled;
+void ImageViewer::updateImage(QImage scaled) {
+    image = drawable(scaled);
     update();
 }
 
+// QPainter would convert other formats on every paint
+QImage ImageViewer::drawable(const QImage &img) const {
+    if(img.format() == QImage::Format_RGB32 ||
+       img.format() == QImage::Format_ARGB32_Premultiplied)
+    {
+        return img;
+    }
+    return img.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+}
+
+// also replaces the source of running tiles, e.g. with a full decode
+void ImageViewer::setSourceImage(QImage source) {
+    if(!sourcePending && (!tiles->hasSource() || source.isNull())) {
+        return;
+    }
+    sourcePending = false;
+    if(source.isNull()) {
+        // back to plain scaling, within its limits
+        tilingAvailable = false;
+        updateMinScale();
+        if(currentScale > minScale) {
+            scaleAround(rect().center(), minScale);
+            updateMap();
+        }
+    } else {
+        tiles->setSource(source);
+    }
+    resizeImage();
+}
+
 void ImageViewer::crop() {
     disconnect(cropOverlay, SIGNAL(selected(QRect)),
                this, SIGNAL(wallpaperSelected(QRect)));
@@ -145,6 +179,11 @@ void ImageViewer::updateMaxScale() {
 }
 
 void ImageViewer::updateMinScale() {
+    // tiles keep memory use flat at any zoom
+    if(tilingAvailable) {
+        minScale = 8.0;
+        return;
+    }
     minScale = 3.0;
     float imgSize = sourceSize.width() * sourceSize.height() / 1000000;
     float maxSize =
@@ -186,11 +225,30 @@ void ImageViewer::resizeImage() {
         return;
     }
     resizeTimer->stop();
-    if(image->size() != drawingRect.size()) {
+    if(useTiles()) {
+        if(!tiles->hasSource()) {
+            if(!sourcePending) {
+                sourcePending = true;
+                emit sourceRequested();
+            }
+            return;
+        }
+        Resampler::Filter filter = (settings->useFastScale() || currentScale < 1.0) ?
+                                   Resampler::FILTER_BILINEAR : Resampler::FILTER_BICUBIC;
+        tiles->setScaledSize(drawingRect.size(), filter);
+        update();
+    } else if(image.size() != drawingRect.size()) {
         emit scalingRequested(drawingRect.size());
     }
 }
 
+// zoomed image is much larger than the screen
+bool ImageViewer::useTiles() const {
+    return tilingAvailable &&
+           (qint64)drawingRect.width() * drawingRect.height() >
+           (qint64)desktopSize.width() * desktopSize.height() * 4;
+}
+
 // ##################################################
 // ####################  PAINT  #####################
 // ##################################################
@@ -199,7 +257,20 @@ void ImageViewer::paintEvent(QPaintEvent *event) {
     QPainter painter(this);
     painter.fillRect(rect(), QBrush(bgColor));
     //painter.setRenderHint(QPainter::SmoothPixmapTransform, true);
-    painter.drawPixmap(drawingRect, *image, image->rect());
+    // only the visible part; drawingRect can be huge when zoomed in
+    QRect target = drawingRect & rect();
+    if(!target.isEmpty() && !image.isNull()) {
+        float sx = (float) image.width() / drawingRect.width();
+        float sy = (float) image.height() / drawingRect.height();
+        QRectF source((target.x() - drawingRect.x()) * sx,
+                      (target.y() - drawingRect.y()) * sy,
+                      target.width() * sx, target.height() * sy);
+        painter.drawImage(QRectF(target), image, source);
+    }
+    // sharp tiles over the stretched pixmap as they become ready
+    if(useTiles()) {
+        tiles->paint(&painter, drawingRect, rect());
+    }
 }
 
 void ImageViewer::mousePressEvent(QMouseEvent *event) {
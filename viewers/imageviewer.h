@@ -21,6 +21,7 @@
 #include "../overlays/cropoverlay.h"
 #include <time.h>
 #include "../lib/imagelib.h"
+#include "tilecache.h"
 
 #define FLT_EPSILON 1.19209290E-07F
 
@@ -47,9 +48,12 @@ signals:
     void wallpaperSelected(QRect);
     void resized(QSize);
     void scalingRequested(QSize);
+    // asks for the full resolution image to render tiles from
+    void sourceRequested();
 
 public slots:
-    void displayImage(QPixmap* _image);
+    // realSize is the full image size when _image is a reduced copy
+    void displayImage(QImage _image, QSize realSize = QSize());
     void slotFitNormal();
     void slotFitWidth();
     void slotFitAll();
@@ -59,7 +63,9 @@ public slots:
     void crop();
     void readSettings();
     void hideCursor();
-    void updateImage(QPixmap *scaled);
+    void updateImage(QImage scaled);
+    // null if the current image can not be shown in tiles
+    void setSourceImage(QImage source);
 
     void selectWallpaper();
 protected:
@@ -70,7 +76,7 @@ protected:
     virtual void resizeEvent(QResizeEvent* event);
 
 private:
-    QPixmap *image;
+    QImage image;
     QTimer *resizeTimer, *cursorTimer;
     QRect drawingRect;
     QPoint mouseMoveStartPos;
@@ -92,6 +98,12 @@ private:
     QPointF fixedZoomPoint;
     QSize desktopSize;
 
+    // large zoomed images are drawn in tiles instead of one scaled pixmap
+    TileCache *tiles;
+    bool tilingAvailable, sourcePending;
+    bool useTiles() const;
+    QImage drawable(const QImage &img) const;
+
     ImageFitMode imageFitMode;
     void initOverlays();
     void setScale(float scale);
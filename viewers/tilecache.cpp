@@ -0,0 +1,157 @@
+#include "tilecache.h"
+
+// tile cost is in KB
+#define TILE_CACHE_LIMIT 131072
+
+TileCache::TileCache(QObject *parent) : QObject(parent) {
+    tiles.setMaxCost(TILE_CACHE_LIMIT);
+}
+
+TileCache::~TileCache() {
+    // running jobs stop after their current tile
+    generation.ref();
+    for(int i = 0; i < jobs.count(); i++) {
+        jobs[i].waitForFinished();
+    }
+}
+
+void TileCache::setSource(QImage image) {
+    // the resampler reads 32 bit pixels
+    if(image.format() != QImage::Format_RGB32 &&
+       image.format() != QImage::Format_ARGB32_Premultiplied)
+    {
+        image = image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    }
+    source = image;
+    resampler.clear();
+    scaledSize = QSize();
+    reset();
+}
+
+bool TileCache::hasSource() const {
+    return !source.isNull();
+}
+
+void TileCache::setScaledSize(QSize size, Resampler::Filter filter) {
+    if(size == scaledSize || source.isNull()) {
+        return;
+    }
+    scaledSize = size;
+    resampler = QSharedPointer<Resampler>(
+                new Resampler(source.width(), source.height(),
+                              size.width(), size.height(), filter));
+    reset();
+}
+
+void TileCache::clear() {
+    source = QImage();
+    resampler.clear();
+    scaledSize = QSize();
+    reset();
+}
+
+void TileCache::reset() {
+    generation.ref();
+    tiles.clear();
+    pending.clear();
+}
+
+quint64 TileCache::key(int column, int row) const {
+    return (quint64)column << 32 | (quint32)row;
+}
+
+// in scaled image coordinates
+QRect TileCache::tileRect(int column, int row, QSize size) const {
+    return QRect(column * TILE_SIZE, row * TILE_SIZE, TILE_SIZE, TILE_SIZE) &
+           QRect(QPoint(0, 0), size);
+}
+
+void TileCache::paint(QPainter *painter, QRect drawingRect, QRect viewport) {
+    if(!resampler || drawingRect.size() != scaledSize) {
+        return;
+    }
+    // visible part in scaled image coordinates
+    QRect visible = viewport.translated(-drawingRect.topLeft()) &
+                    QRect(QPoint(0, 0), scaledSize);
+    if(visible.isEmpty()) {
+        return;
+    }
+    int firstColumn = visible.left() / TILE_SIZE;
+    int lastColumn = visible.right() / TILE_SIZE;
+    int firstRow = visible.top() / TILE_SIZE;
+    int lastRow = visible.bottom() / TILE_SIZE;
+    QList<QPoint> missing;
+    for(int row = firstRow; row <= lastRow; row++) {
+        for(int column = firstColumn; column <= lastColumn; column++) {
+            QPixmap *tile = tiles.object(key(column, row));
+            if(tile) {
+                painter->drawPixmap(tileRect(column, row, scaledSize).topLeft() +
+                                    drawingRect.topLeft(), *tile);
+            } else {
+                missing.append(QPoint(column, row));
+            }
+        }
+    }
+    // prefetch one tile around the visible ones
+    int columns = (scaledSize.width() - 1) / TILE_SIZE;
+    int rows = (scaledSize.height() - 1) / TILE_SIZE;
+    for(int row = qMax(firstRow - 1, 0); row <= qMin(lastRow + 1, rows); row++) {
+        for(int column = qMax(firstColumn - 1, 0); column <= qMin(lastColumn + 1, columns); column++) {
+            if(row < firstRow || row > lastRow || column < firstColumn || column > lastColumn) {
+                if(!tiles.contains(key(column, row))) {
+                    missing.append(QPoint(column, row));
+                }
+            }
+        }
+    }
+    request(missing);
+}
+
+void TileCache::request(QList<QPoint> missing) {
+    QList<QPoint> requested;
+    for(int i = 0; i < missing.count(); i++) {
+        quint64 k = key(missing.at(i).x(), missing.at(i).y());
+        if(!pending.contains(k)) {
+            pending.insert(k);
+            requested.append(missing.at(i));
+        }
+    }
+    if(!requested.isEmpty()) {
+        for(int i = jobs.count() - 1; i >= 0; i--) {
+            if(jobs.at(i).isFinished()) {
+                jobs.removeAt(i);
+            }
+        }
+        jobs.append(QtConcurrent::run(this, &TileCache::render, source, resampler,
+                                      scaledSize, requested, generation.load()));
+    }
+}
+
+void TileCache::render(QImage image, QSharedPointer<Resampler> scaler,
+                       QSize size, QList<QPoint> missing, int expected)
+{
+    for(int i = 0; i < missing.count(); i++) {
+        if(generation.load() != expected) {
+            return;
+        }
+        QRect area = tileRect(missing.at(i).x(), missing.at(i).y(), size);
+        QImage tile(area.size(), image.format());
+        scaler->resampleArea(image.constBits(), image.bytesPerLine(),
+                             tile.bits(), tile.bytesPerLine(),
+                             area.left(), area.top(), area.width(), area.height());
+        QMetaObject::invokeMethod(this, "onTileReady", Qt::QueuedConnection,
+                                  Q_ARG(QPoint, missing.at(i)),
+                                  Q_ARG(QImage, tile),
+                                  Q_ARG(int, expected));
+    }
+}
+
+void TileCache::onTileReady(QPoint tile, QImage image, int expected) {
+    if(expected != generation.load()) {
+        return;
+    }
+    quint64 k = key(tile.x(), tile.y());
+    pending.remove(k);
+    tiles.insert(k, new QPixmap(QPixmap::fromImage(image)), image.byteCount() / 1024);
+    emit tilesReady();
+}
@@ -0,0 +1,65 @@
+#ifndef TILECACHE_H
+#define TILECACHE_H
+
+#include <QObject>
+#include <QImage>
+#include <QPixmap>
+#include <QPainter>
+#include <QCache>
+#include <QSet>
+#include <QSharedPointer>
+#include <QAtomicInt>
+#include <QFuture>
+#include <QtConcurrent>
+#include "../lib/resampler.h"
+
+// Renders a zoomed image in fixed size tiles.
+// Only tiles around the visible area are scaled (in background)
+// and a bounded number of them is kept, so memory use does not
+// depend on the zoom level.
+class TileCache : public QObject
+{
+    Q_OBJECT
+public:
+    explicit TileCache(QObject *parent = 0);
+    ~TileCache();
+
+    // full resolution source, shared with the image
+    void setSource(QImage image);
+    bool hasSource() const;
+    // size of the whole zoomed image
+    void setScaledSize(QSize size, Resampler::Filter filter);
+    // draws cached tiles of the image placed at drawingRect
+    // which intersect viewport, requests the missing ones
+    void paint(QPainter *painter, QRect drawingRect, QRect viewport);
+    void clear();
+
+    const int TILE_SIZE = 256;
+
+signals:
+    void tilesReady();
+
+private:
+    QImage source;
+    QSize scaledSize;
+    QSharedPointer<Resampler> resampler;
+    QCache<quint64, QPixmap> tiles;
+    QSet<quint64> pending;
+    // bumped whenever cached and pending tiles become invalid
+    QAtomicInt generation;
+    // render jobs use this object; destructor waits for them
+    QList< QFuture<void> > jobs;
+
+    quint64 key(int column, int row) const;
+    QRect tileRect(int column, int row, QSize size) const;
+    void reset();
+    void request(QList<QPoint> missing);
+    // runs in a pool thread
+    void render(QImage image, QSharedPointer<Resampler> scaler,
+                QSize size, QList<QPoint> missing, int expected);
+
+private slots:
+    void onTileReady(QPoint tile, QImage image, int expected);
+};
+
+#endif // TILECACHE_H